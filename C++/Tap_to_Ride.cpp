@@ -1,7 +1,6 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <map>
 #include <cmath>
 #include <queue>
 #include <iomanip>
@@ -10,10 +9,210 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <list>
+#include <string_view>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <charconv>
+#include <random>
+#include <new>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TAP_TO_RIDE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
 
 #ifdef _WIN32
+#define NOMINMAX
 #include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const double EARTH_RADIUS_KM = 6371.0;
+const double DEG_TO_RAD = 3.14159 / 180.0;   // same pi as calculateDistance
+
+// Heap allocations made by every thread, reported per operation by --bench.
+// Shared rather than per thread, so work handed to a background build is
+// counted too. Build with -DTAP_TO_RIDE_COUNT_ALLOCATIONS=0 to keep the
+// library allocator untouched.
+#ifndef TAP_TO_RIDE_COUNT_ALLOCATIONS
+#define TAP_TO_RIDE_COUNT_ALLOCATIONS 1
+#endif
+std::atomic<unsigned long long> heapAllocations{0};
+
+#if TAP_TO_RIDE_COUNT_ALLOCATIONS
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* block = std::malloc(size)) return block;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+// Out of line so GCC does not pair the inlined free() with new expressions.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    operator delete(block);
+}
+
+// The library's nothrow and array forms call the ones above; the aligned
+// forms do not, so they are counted here too.
+// MSVC has no std::aligned_alloc; its aligned blocks need _aligned_free.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+    while (true) {
+#ifdef _WIN32
+        if (void* block = _aligned_malloc(rounded, align)) return block;
+#else
+        if (void* block = std::aligned_alloc(align, rounded)) return block;
 #endif
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* block, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(block, alignment);
+}
+#endif
+
+// xoshiro256** seeded through splitmix64. An instance belongs to one thread,
+// so drawing a number never locks or touches shared state.
+class Xoshiro256 {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    static uint64_t splitMix(uint64_t& x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    explicit Xoshiro256(uint64_t seed = 0) {
+        for (auto& word : state) word = splitMix(seed);
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound); rejects the few low values that would bias the modulo.
+    uint64_t below(uint64_t bound) {
+        uint64_t threshold = (0 - bound) % bound;
+        uint64_t r = next();
+        while (r < threshold) r = next();
+        return r % bound;
+    }
+
+    // Uniform in [0, 1) with 53 random bits.
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// One process-wide seed, split into independent numbered streams. Each thread
+// draws from its own stream (handed out in first-use order); work that must
+// not depend on thread scheduling asks for a fixed stream id instead.
+class RandomService {
+private:
+    static const uint64_t THREAD_STREAMS = 1ULL << 32;
+
+    static std::atomic<uint64_t>& seedValue() {
+        static std::atomic<uint64_t> value{std::random_device()() ^ static_cast<uint64_t>(time(NULL))};
+        return value;
+    }
+
+    static std::atomic<uint64_t>& seedVersion() {
+        static std::atomic<uint64_t> version{1};
+        return version;
+    }
+
+    static std::atomic<uint64_t>& threadsSeeded() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+
+public:
+    enum Stream : uint64_t { Report = 1, Benchmark = 2 };
+
+    static uint64_t seed() {
+        return seedValue().load();
+    }
+
+    // Reseeds every thread's generator the next time that thread draws.
+    static void setSeed(uint64_t value) {
+        seedValue().store(value);
+        threadsSeeded().store(0);
+        seedVersion().fetch_add(1);
+    }
+
+    static Xoshiro256 stream(uint64_t id) {
+        uint64_t mix = seed() + id * 0xd1b54a32d192ed03ULL;
+        return Xoshiro256(Xoshiro256::splitMix(mix));
+    }
+
+    static Xoshiro256& local() {
+        thread_local Xoshiro256 generator;
+        thread_local uint64_t version = 0;
+        uint64_t current = seedVersion().load(std::memory_order_acquire);
+        if (version != current) {
+            generator = stream(THREAD_STREAMS + threadsSeeded().fetch_add(1));
+            version = current;
+        }
+        return generator;
+    }
+};
 
 class WeatherSystem {
 private:
@@ -22,7 +221,6 @@ private:
 public:
     WeatherSystem() {
         weatherConditions = {"Sunny", "Cloudy", "Rainy", "Foggy", "Heavy Rain", "Stormy"};
-        srand(static_cast<unsigned int>(time(NULL)));
     }
 
     double getWeatherImpact(const std::string& condition) {
@@ -36,7 +234,7 @@ public:
     }
 
     std::string getRandomWeather() {
-        int index = rand() % weatherConditions.size();
+        int index = static_cast<int>(RandomService::local().below(weatherConditions.size()));
         return weatherConditions[index];
     }
 
@@ -60,147 +258,4309 @@ struct SegmentInfo {
     double weatherImpact;
     double fare;
     std::string trafficColor;
+    std::string trafficStatus;
     int travelTime;
 };
 
-class DhakaBusSystem {
+struct RouteEdge {
+    int from;
+    int to;
+    double weight;
+};
+
+enum class SearchMode {
+    Dijkstra,
+    AStar,
+    Bidirectional,
+    ContractionHierarchy,
+    Landmarks
+};
+
+const char* searchModeName(SearchMode mode) {
+    switch (mode) {
+        case SearchMode::AStar: return "astar";
+        case SearchMode::Bidirectional: return "bidirectional";
+        case SearchMode::ContractionHierarchy: return "ch";
+        case SearchMode::Landmarks: return "alt";
+        default: return "dijkstra";
+    }
+}
+
+bool parseSearchMode(const std::string& text, SearchMode& mode) {
+    if (text == "dijkstra") mode = SearchMode::Dijkstra;
+    else if (text == "astar") mode = SearchMode::AStar;
+    else if (text == "bidirectional") mode = SearchMode::Bidirectional;
+    else if (text == "ch") mode = SearchMode::ContractionHierarchy;
+    else if (text == "alt") mode = SearchMode::Landmarks;
+    else return false;
+    return true;
+}
+
+struct SearchStats {
+    long long queries = 0;
+    long long settledNodes = 0;
+    long long relaxedEdges = 0;
+    long long heapPushes = 0;
+    long long heapPops = 0;
+    long long stalePops = 0;
+
+    void add(const SearchStats& other) {
+        queries += other.queries;
+        settledNodes += other.settledNodes;
+        relaxedEdges += other.relaxedEdges;
+        heapPushes += other.heapPushes;
+        heapPops += other.heapPops;
+        stalePops += other.stalePops;
+    }
+};
+
+enum class HeapKind {
+    Binary,     // std::priority_queue with lazy deletion
+    Quad,       // indexed 4-ary heap with decrease-key
+    Radix       // radix heap over monotone keys
+};
+
+// Build with -DTAP_TO_RIDE_HEAP=1 (quad) or 2 (radix) to change the default;
+// --heap=binary|quad|radix overrides it at runtime.
+#ifndef TAP_TO_RIDE_HEAP
+#define TAP_TO_RIDE_HEAP 0
+#endif
+const HeapKind DEFAULT_HEAP = static_cast<HeapKind>(TAP_TO_RIDE_HEAP);
+
+const char* heapKindName(HeapKind kind) {
+    switch (kind) {
+        case HeapKind::Quad: return "quad";
+        case HeapKind::Radix: return "radix";
+        default: return "binary";
+    }
+}
+
+bool parseHeapKind(const std::string& text, HeapKind& kind) {
+    if (text == "binary") kind = HeapKind::Binary;
+    else if (text == "quad") kind = HeapKind::Quad;
+    else if (text == "radix") kind = HeapKind::Radix;
+    else return false;
+    return true;
+}
+
+// All three heaps share push(key, id) / pop(key, id) / topKey() / empty() /
+// clear(). Lazy heaps may hand back stale entries; the search skips settled
+// places.
+class LazyBinaryHeap {
 private:
-    std::map<std::string, std::pair<double, double>> places;
-    std::map<std::string, std::vector<std::pair<std::string, double>>> graph;
-    WeatherSystem weatherSystem;
-    std::string currentWeather;
-    const double BASE_FARE_PER_KM = 2.45;
+    using Pair = std::pair<double, int>;
+    std::vector<Pair> heap;     // kept across clear() so reuse does not allocate
 
 public:
-    DhakaBusSystem() {
-        currentWeather = weatherSystem.getRandomWeather();
-        loadLocationsFromFile();
-        buildGraph();
-        std::cout << "🚌 Dhaka Bus System Initialized!\n";
-        std::cout << "💰 Fare Rate: " << BASE_FARE_PER_KM << " per km (Direct Distance)\n";
-        std::cout << "🌤️  Current Weather: " << currentWeather << "\n\n";
+    void clear() { heap.clear(); }
+    bool empty() const { return heap.empty(); }
+    double topKey() const { return heap.front().first; }
+
+    void push(double key, int id) {
+        heap.push_back(std::make_pair(key, id));
+        std::push_heap(heap.begin(), heap.end(), std::greater<Pair>());
     }
 
-    void loadLocationsFromFile() {
-        std::ifstream file("locations.txt");
+    void pop(double& key, int& id) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Pair>());
+        key = heap.back().first;
+        id = heap.back().second;
+        heap.pop_back();
+    }
+};
 
-        if (!file.is_open()) {
-            std::cout << "⚠️ Error: locations.txt file pawa jacche na! Program bondho hoye jabe.\n";
+// 4-ary heap with a position index, so a second push of the same place is a
+// decrease-key and nothing stale is ever popped.
+class IndexedQuadHeap {
+private:
+    std::vector<std::pair<double, int>> heap;
+    std::vector<int> position;      // index in heap, -1 when absent
+
+    void place(size_t i, const std::pair<double, int>& item) {
+        heap[i] = item;
+        position[item.second] = static_cast<int>(i);
+    }
+
+    void siftUp(size_t i) {
+        std::pair<double, int> item = heap[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / 4;
+            if (heap[parent].first <= item.first) break;
+            place(i, heap[parent]);
+            i = parent;
+        }
+        place(i, item);
+    }
+
+    void siftDown(size_t i) {
+        std::pair<double, int> item = heap[i];
+        size_t count = heap.size();
+        while (true) {
+            size_t first = 4 * i + 1;
+            if (first >= count) break;
+            size_t best = first;
+            size_t last = std::min(first + 4, count);
+            for (size_t c = first + 1; c < last; c++) {
+                if (heap[c].first < heap[best].first) best = c;
+            }
+            if (heap[best].first >= item.first) break;
+            place(i, heap[best]);
+            i = best;
+        }
+        place(i, item);
+    }
+
+public:
+    void reserve(int places) {
+        if (static_cast<int>(position.size()) < places) position.resize(places, -1);
+    }
+
+    void clear() {
+        for (auto& item : heap) position[item.second] = -1;
+        heap.clear();
+    }
+
+    bool empty() const { return heap.empty(); }
+    double topKey() const { return heap.front().first; }
+
+    void push(double key, int id) {
+        reserve(id + 1);
+        int at = position[id];
+        if (at >= 0) {
+            if (key < heap[at].first) {
+                heap[at].first = key;
+                siftUp(at);
+            }
             return;
         }
+        heap.push_back(std::make_pair(key, id));
+        siftUp(heap.size() - 1);
+    }
 
-        std::string name;
-        double lat, lon;
-        int count = 0;
+    void pop(double& key, int& id) {
+        key = heap[0].first;
+        id = heap[0].second;
+        position[id] = -1;
+        std::pair<double, int> last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            heap[0] = last;
+            siftDown(0);
+        }
+    }
+};
+
+// Radix heap for monotone integer keys. Non-negative doubles order the same
+// way as their IEEE-754 bit patterns, so the search keys are used as 64-bit
+// integers directly; a key that rounds below the last pop is clamped to it.
+class RadixHeap {
+private:
+    std::vector<std::pair<uint64_t, int>> buckets[65];
+    uint64_t last = 0;
+    size_t count = 0;
+
+    static uint64_t toBits(double key) {
+        uint64_t bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(uint64_t bits) {
+        double key;
+        std::memcpy(&key, &bits, sizeof(key));
+        return key;
+    }
+
+    static int bucketOf(uint64_t bits, uint64_t base) {
+        uint64_t diff = bits ^ base;
+        if (diff == 0) return 0;
+#if defined(__GNUC__)
+        return 64 - __builtin_clzll(diff);
+#else
+        int bit = 0;
+        while (diff) {
+            diff >>= 1;
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+public:
+    void clear() {
+        for (auto& bucket : buckets) bucket.clear();
+        last = 0;
+        count = 0;
+    }
+
+    bool empty() const { return count == 0; }
+
+    void push(double key, int id) {
+        uint64_t bits = std::max(toBits(key), last);
+        buckets[bucketOf(bits, last)].push_back(std::make_pair(bits, id));
+        count++;
+    }
+
+    // Moves the smallest keys into bucket 0, where every key equals last.
+    void gatherMinimum() {
+        if (!buckets[0].empty()) return;
+        int i = 1;
+        while (buckets[i].empty()) i++;
+        uint64_t smallest = buckets[i][0].first;
+        for (auto& item : buckets[i]) smallest = std::min(smallest, item.first);
+        last = smallest;
+        for (auto& item : buckets[i]) {
+            buckets[bucketOf(item.first, last)].push_back(item);
+        }
+        buckets[i].clear();
+    }
+
+    double topKey() {
+        gatherMinimum();
+        return fromBits(last);
+    }
+
+    void pop(double& key, int& id) {
+        gatherMinimum();
+        key = fromBits(buckets[0].back().first);
+        id = buckets[0].back().second;
+        buckets[0].pop_back();
+        count--;
+    }
+};
+
+// Flat per-place labels for one search direction. A label only counts when
+// its stamp matches the current generation, so reset() is O(1) instead of
+// refilling n entries before every query.
+class SearchLabels {
+private:
+    struct Label {
+        double dist;
+        double estimate;        // cached heuristic, -1 until computed
+        int parent;
+        int arc;                // edge used to reach this place, -1 if none
+        uint32_t reached;
+        uint32_t settled;
+    };
+    std::vector<Label> labels;
+    uint32_t generation = 0;
+
+public:
+    void reset(int places) {
+        if (static_cast<int>(labels.size()) < places) {
+            labels.resize(places, Label{1e18, -1.0, -1, -1, 0, 0});
+        }
+        if (++generation == 0) {
+            for (auto& label : labels) label.reached = label.settled = 0;
+            generation = 1;
+        }
+    }
+
+    bool reached(int v) const { return labels[v].reached == generation; }
+    double distance(int v) const { return reached(v) ? labels[v].dist : 1e18; }
+    int parent(int v) const { return reached(v) ? labels[v].parent : -1; }
+    int arc(int v) const { return reached(v) ? labels[v].arc : -1; }
+
+    void update(int v, double dist, int parent, int arc = -1) {
+        Label& label = labels[v];
+        if (label.reached != generation) {
+            label.reached = generation;
+            label.estimate = -1.0;
+        }
+        label.dist = dist;
+        label.parent = parent;
+        label.arc = arc;
+    }
+
+    // Only valid for a reached place.
+    double& estimate(int v) { return labels[v].estimate; }
+
+    bool settled(int v) const { return labels[v].settled == generation; }
+    void settle(int v) { labels[v].settled = generation; }
+
+    // Writes the parent chain ending at v into path, first stop first.
+    void tracePath(int v, std::vector<int>& path) const {
+        size_t length = 0;
+        for (int current = v; current != -1; current = parent(current)) length++;
+        path.resize(length);
+        for (int current = v; current != -1; current = parent(current)) path[--length] = current;
+    }
+};
+
+// Everything a query needs besides the graph, one per thread and reused for
+// every search it runs. Bidirectional searches use both sides.
+struct SearchWorkspace {
+    SearchLabels labels[2];
+    LazyBinaryHeap binaryHeap[2];
+    IndexedQuadHeap quadHeap[2];
+    RadixHeap radixHeap[2];
+    std::vector<int> chain;
+    SearchLabels excluded;      // places a constrained search must not enter (settled = excluded)
+
+    static SearchWorkspace& local() {
+        thread_local SearchWorkspace workspace;
+        return workspace;
+    }
+
+    // Calls search with the pair of heaps of the given kind, so one search
+    // body templated on the heap serves every --heap choice.
+    template <typename Search>
+    void withHeaps(HeapKind kind, const Search& search) {
+        switch (kind) {
+            case HeapKind::Quad: search(quadHeap); break;
+            case HeapKind::Radix: search(radixHeap); break;
+            default: search(binaryHeap); break;
+        }
+    }
+};
+
+struct PlaceEntry {
+    std::string name;
+    double lat;
+    double lon;
+};
+
+// Great-circle distances from unit-vector columns (x, y, z on the sphere).
+// The haversine term a equals chord^2 / 4, so distance = 2R * asin(chord / 2)
+// and "distance < r" is just "chord^2 < (2 sin(r / 2R))^2": the batch kernel
+// needs no trig at all. Coordinates are differenced directly, so the error
+// against calculateDistance stays below 1e-9 km at city scale (the routing
+// report prints the observed maximum). The AVX2 path evaluates the same
+// expression in the same order as the scalar one, so results are identical.
+class GeoKernel {
+public:
+    static double chordToKm(double chordSquared) {
+        return 2 * EARTH_RADIUS_KM * std::asin(std::min(1.0, std::sqrt(chordSquared) / 2));
+    }
+
+    static double radiusToChordSquared(double radiusKm) {
+        if (radiusKm >= 3.14159 * EARTH_RADIUS_KM) return 4.0;
+        double chord = 2 * std::sin(radiusKm / (2 * EARTH_RADIUS_KM));
+        return chord * chord;
+    }
+
+    static bool hasAvx2() {
+#ifdef TAP_TO_RIDE_AVX2_KERNEL
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    static void chordSquaredScalar(double qx, double qy, double qz, const double* xs, const double* ys,
+                                   const double* zs, int count, double* out) {
+        for (int i = 0; i < count; i++) {
+            double dx = xs[i] - qx;
+            double dy = ys[i] - qy;
+            double dz = zs[i] - qz;
+            out[i] = dx * dx + dy * dy + dz * dz;
+        }
+    }
+
+    static int withinScalar(double qx, double qy, double qz, const double* xs, const double* ys,
+                            const double* zs, int count, double limit, int* hits, double* hitChords) {
+        int found = 0;
+        for (int i = 0; i < count; i++) {
+            double dx = xs[i] - qx;
+            double dy = ys[i] - qy;
+            double dz = zs[i] - qz;
+            double c2 = dx * dx + dy * dy + dz * dz;
+            if (c2 < limit) {
+                hits[found] = i;
+                hitChords[found] = c2;
+                found++;
+            }
+        }
+        return found;
+    }
+
+#ifdef TAP_TO_RIDE_AVX2_KERNEL
+    __attribute__((target("avx2")))
+    static void chordSquaredAvx2(double qx, double qy, double qz, const double* xs, const double* ys,
+                                 const double* zs, int count, double* out) {
+        __m256d vx = _mm256_set1_pd(qx);
+        __m256d vy = _mm256_set1_pd(qy);
+        __m256d vz = _mm256_set1_pd(qz);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), vx);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), vy);
+            __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(zs + i), vz);
+            __m256d c2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                       _mm256_mul_pd(dz, dz));
+            _mm256_storeu_pd(out + i, c2);
+        }
+        chordSquaredScalar(qx, qy, qz, xs + i, ys + i, zs + i, count - i, out + i);
+    }
+
+    __attribute__((target("avx2")))
+    static int withinAvx2(double qx, double qy, double qz, const double* xs, const double* ys,
+                          const double* zs, int count, double limit, int* hits, double* hitChords) {
+        __m256d vx = _mm256_set1_pd(qx);
+        __m256d vy = _mm256_set1_pd(qy);
+        __m256d vz = _mm256_set1_pd(qz);
+        __m256d vlimit = _mm256_set1_pd(limit);
+        alignas(32) double lanes[4];
+        int found = 0;
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), vx);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), vy);
+            __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(zs + i), vz);
+            __m256d c2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                       _mm256_mul_pd(dz, dz));
+            int mask = _mm256_movemask_pd(_mm256_cmp_pd(c2, vlimit, _CMP_LT_OQ));
+            if (mask == 0) continue;
+            _mm256_store_pd(lanes, c2);
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    hits[found] = i + lane;
+                    hitChords[found] = lanes[lane];
+                    found++;
+                }
+            }
+        }
+        int tail = withinScalar(qx, qy, qz, xs + i, ys + i, zs + i, count - i, limit, hits + found, hitChords + found);
+        for (int k = found; k < found + tail; k++) hits[k] += i;
+        return found + tail;
+    }
+#endif
+
+    // Squared chord from (qx, qy, qz) to each of the count columns entries.
+    static void chordSquared(double qx, double qy, double qz, const double* xs, const double* ys,
+                             const double* zs, int count, double* out, bool allowAvx2 = true) {
+#ifdef TAP_TO_RIDE_AVX2_KERNEL
+        if (allowAvx2 && hasAvx2()) {
+            chordSquaredAvx2(qx, qy, qz, xs, ys, zs, count, out);
+            return;
+        }
+#endif
+        (void)allowAvx2;
+        chordSquaredScalar(qx, qy, qz, xs, ys, zs, count, out);
+    }
+
+    // Threshold mask: writes the indices (and squared chords) of entries whose
+    // squared chord is below limit; returns how many there are.
+    static int within(double qx, double qy, double qz, const double* xs, const double* ys, const double* zs,
+                      int count, double limit, int* hits, double* hitChords, bool allowAvx2 = true) {
+#ifdef TAP_TO_RIDE_AVX2_KERNEL
+        if (allowAvx2 && hasAvx2()) {
+            return withinAvx2(qx, qy, qz, xs, ys, zs, count, limit, hits, hitChords);
+        }
+#endif
+        (void)allowAvx2;
+        return withinScalar(qx, qy, qz, xs, ys, zs, count, limit, hits, hitChords);
+    }
+};
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) return false;
+        if (fileSize.QuadPart == 0) return true;    // nothing to map
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) return false;
+        bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        length = static_cast<size_t>(fileSize.QuadPart);
+        return bytes != nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) return false;
+        if (info.st_size == 0) return true;         // nothing to map
+        void* addr = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) return false;
+        bytes = static_cast<const char*>(addr);
+        length = static_cast<size_t>(info.st_size);
+        return true;
+#endif
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// Flat array that either owns its elements or borrows them from a mapped
+// snapshot. Copies share the owned elements; borrowed or shared arrays are
+// copied out the first time they are modified, so a published network never
+// changes underneath its readers.
+template <typename T>
+class FlatArray {
+private:
+    std::shared_ptr<std::vector<T>> owned;
+    const T* items = nullptr;
+    size_t count = 0;
+    bool borrowed = false;
+
+    void repoint() {
+        items = owned->data();
+        count = owned->size();
+    }
+
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* data() const { return items; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    const T& back() const { return items[count - 1]; }
+    const T& operator[](size_t i) const { return items[i]; }
+
+    void assign(std::vector<T>&& values) {
+        owned = std::make_shared<std::vector<T>>(std::move(values));
+        borrowed = false;
+        repoint();
+    }
+
+    void borrow(const T* values, size_t n) {
+        owned.reset();
+        items = values;
+        count = n;
+        borrowed = true;
+    }
+
+    // Only the thread that owns this copy may call modify(); use_count() is
+    // stable because nobody else can make new copies of it.
+    template <typename Edit>
+    void modify(Edit edit) {
+        if (borrowed || !owned) {
+            owned = std::make_shared<std::vector<T>>(items, items + count);
+            borrowed = false;
+        } else if (owned.use_count() > 1) {
+            owned = std::make_shared<std::vector<T>>(*owned);
+        }
+        edit(*owned);
+        repoint();
+    }
+};
+
+// Place names are interned once into dense ids (file order); adjacency is
+// stored as compressed sparse rows so route searches only touch flat arrays.
+// Every array can also point straight into a memory-mapped snapshot.
+struct BusNetwork {
+    FlatArray<char> nameChars;          // all names back to back
+    FlatArray<uint32_t> nameOffsets;    // name of id i is [nameOffsets[i], nameOffsets[i + 1])
+    FlatArray<double> latitudes;
+    FlatArray<double> longitudes;
+    FlatArray<double> unitX;            // unit vectors from the radian latitude/longitude and
+    FlatArray<double> unitY;            // cos(latitude), precomputed once for GeoKernel
+    FlatArray<double> unitZ;
+    FlatArray<int> sortedIds;           // ids ordered by name, for lookup and listing
+
+    // Edges of place u live in [edgeOffsets[u], edgeOffsets[u + 1]).
+    FlatArray<int> edgeOffsets;
+    FlatArray<int> edgeTargets;
+    FlatArray<double> edgeWeights;
+
+    std::shared_ptr<const MappedFile> mapping;    // keeps borrowed arrays alive
+
+    int size() const {
+        return static_cast<int>(latitudes.size());
+    }
+
+    static void unitVector(double lat, double lon, double& x, double& y, double& z) {
+        double latRad = lat * DEG_TO_RAD;
+        double lonRad = lon * DEG_TO_RAD;
+        double cosLat = std::cos(latRad);
+        x = cosLat * std::cos(lonRad);
+        y = cosLat * std::sin(lonRad);
+        z = std::sin(latRad);
+    }
+
+    double chordSquared(int a, int b) const {
+        double dx = unitX[a] - unitX[b];
+        double dy = unitY[a] - unitY[b];
+        double dz = unitZ[a] - unitZ[b];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Same value as calculateDistance on the stored coordinates.
+    double distance(int a, int b) const {
+        return GeoKernel::chordToKm(chordSquared(a, b));
+    }
+
+    // Straight-line (through the earth) distance: never more than distance(),
+    // and a metric, so it is a consistent A* heuristic without any trig.
+    double chordLowerBound(int a, int b) const {
+        return EARTH_RADIUS_KM * std::sqrt(chordSquared(a, b));
+    }
+
+    std::string_view name(int id) const {
+        return std::string_view(nameChars.data() + nameOffsets[id], nameOffsets[id + 1] - nameOffsets[id]);
+    }
+
+    const int* lowerBound(const std::string& key) const {
+        return std::lower_bound(sortedIds.begin(), sortedIds.end(), key,
+                                [this](int id, const std::string& k) { return name(id) < k; });
+    }
+
+    int findId(const std::string& key) const {
+        const int* it = lowerBound(key);
+        if (it != sortedIds.end() && name(*it) == key) return *it;
+        return -1;
+    }
+
+    // Up to limit ids whose names start with prefix, in name order.
+    void completePrefix(std::string_view prefix, size_t limit, std::vector<int>& ids) const {
+        ids.clear();
+        const int* it = std::lower_bound(sortedIds.begin(), sortedIds.end(), prefix,
+                                         [this](int id, std::string_view k) { return name(id) < k; });
+        for (; it != sortedIds.end() && ids.size() < limit; ++it) {
+            if (name(*it).substr(0, prefix.size()) != prefix) break;
+            ids.push_back(*it);
+        }
+    }
+
+    // Names within maxDistance edits of query (letter case is free), closest
+    // first. sortedIds is walked as an implicit trie: edit-distance rows for a
+    // shared prefix are reused by the next name, and once every entry of a row
+    // exceeds maxDistance all names below that prefix are skipped at once.
+    void fuzzyFind(std::string_view query, int maxDistance, size_t limit,
+                   std::vector<std::pair<int, int>>& matches) const {
+        matches.clear();
+        auto fold = [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; };
+        size_t width = query.size() + 1;
+        std::vector<int> rows(width);
+        for (size_t j = 0; j < width; j++) rows[j] = static_cast<int>(j);
+
+        std::string_view previous;
+        size_t validDepth = 0;      // rows 0..validDepth belong to previous's prefix
+        const int* it = sortedIds.begin();
+        while (it != sortedIds.end()) {
+            std::string_view candidate = name(*it);
+            size_t depth = 0;
+            while (depth < validDepth && depth < candidate.size() && previous[depth] == candidate[depth]) depth++;
+            if (rows.size() < (candidate.size() + 1) * width) rows.resize((candidate.size() + 1) * width);
+
+            bool pruned = false;
+            for (; depth < candidate.size(); depth++) {
+                const int* above = rows.data() + depth * width;
+                int* row = rows.data() + (depth + 1) * width;
+                row[0] = static_cast<int>(depth + 1);
+                int rowMin = row[0];
+                char c = fold(candidate[depth]);
+                for (size_t j = 1; j < width; j++) {
+                    int substitute = above[j - 1] + (c != fold(query[j - 1]));
+                    row[j] = std::min(std::min(above[j] + 1, row[j - 1] + 1), substitute);
+                    rowMin = std::min(rowMin, row[j]);
+                }
+                if (rowMin > maxDistance) {
+                    pruned = true;
+                    break;
+                }
+            }
+
+            previous = candidate;
+            if (pruned) {
+                // Every name sharing candidate's first depth + 1 characters is too far.
+                std::string_view dead = candidate.substr(0, depth + 1);
+                validDepth = depth;
+                it = std::partition_point(it, sortedIds.end(),
+                                          [&](int id) { return name(id).substr(0, dead.size()) == dead; });
+                continue;
+            }
+            validDepth = candidate.size();
+            int distance = rows[candidate.size() * width + query.size()];
+            if (distance <= maxDistance) matches.emplace_back(distance, *it);
+            ++it;
+        }
+
+        std::stable_sort(matches.begin(), matches.end(),
+                         [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; });
+        if (matches.size() > limit) matches.resize(limit);
+    }
+
+    // Returns the id of the place, updating its coordinates if it already exists.
+    int addPlace(const std::string& placeName, double lat, double lon) {
+        const int* it = lowerBound(placeName);
+        size_t position = it - sortedIds.begin();
+        double x, y, z;
+        unitVector(lat, lon, x, y, z);
+        if (it != sortedIds.end() && name(*it) == placeName) {
+            int existing = *it;
+            latitudes.modify([&](std::vector<double>& v) { v[existing] = lat; });
+            longitudes.modify([&](std::vector<double>& v) { v[existing] = lon; });
+            unitX.modify([&](std::vector<double>& v) { v[existing] = x; });
+            unitY.modify([&](std::vector<double>& v) { v[existing] = y; });
+            unitZ.modify([&](std::vector<double>& v) { v[existing] = z; });
+            return existing;
+        }
+
+        int id = size();
+        if (nameOffsets.empty()) {
+            nameOffsets.assign(std::vector<uint32_t>(1, 0));
+        }
+        nameChars.modify([&](std::vector<char>& v) { v.insert(v.end(), placeName.begin(), placeName.end()); });
+        nameOffsets.modify([&](std::vector<uint32_t>& v) { v.push_back(static_cast<uint32_t>(nameChars.size())); });
+        latitudes.modify([&](std::vector<double>& v) { v.push_back(lat); });
+        longitudes.modify([&](std::vector<double>& v) { v.push_back(lon); });
+        unitX.modify([&](std::vector<double>& v) { v.push_back(x); });
+        unitY.modify([&](std::vector<double>& v) { v.push_back(y); });
+        unitZ.modify([&](std::vector<double>& v) { v.push_back(z); });
+        sortedIds.modify([&](std::vector<int>& v) { v.insert(v.begin() + position, id); });
+        return id;
+    }
+
+    // Replaces the whole place table in one go and sorts the name index once.
+    void setPlaces(std::vector<char>&& chars, std::vector<uint32_t>&& offsets,
+                   std::vector<double>&& lats, std::vector<double>&& lons) {
+        nameChars.assign(std::move(chars));
+        nameOffsets.assign(std::move(offsets));
+        latitudes.assign(std::move(lats));
+        longitudes.assign(std::move(lons));
+
+        std::vector<double> xs(size()), ys(size()), zs(size());
+        for (int id = 0; id < size(); id++) {
+            unitVector(latitudes[id], longitudes[id], xs[id], ys[id], zs[id]);
+        }
+        unitX.assign(std::move(xs));
+        unitY.assign(std::move(ys));
+        unitZ.assign(std::move(zs));
+
+        std::vector<int> order(size());
+        for (int id = 0; id < size(); id++) order[id] = id;
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return name(a) < name(b); });
+        sortedIds.assign(std::move(order));
+        edgeOffsets.assign(std::vector<int>(size() + 1, 0));
+        edgeTargets.assign(std::vector<int>());
+        edgeWeights.assign(std::vector<double>());
+    }
+
+    // Replaces the adjacency with the given directed edges (from, to, weight).
+    void setEdges(const std::vector<RouteEdge>& edges) {
+        int n = size();
+        std::vector<int> offsets(n + 1, 0);
+        for (auto& edge : edges) {
+            offsets[edge.from + 1]++;
+        }
+        for (int u = 0; u < n; u++) {
+            offsets[u + 1] += offsets[u];
+        }
+
+        std::vector<int> targets(edges.size(), 0);
+        std::vector<double> weights(edges.size(), 0.0);
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        for (auto& edge : edges) {
+            int slot = cursor[edge.from]++;
+            targets[slot] = edge.to;
+            weights[slot] = edge.weight;
+        }
+
+        edgeOffsets.assign(std::move(offsets));
+        edgeTargets.assign(std::move(targets));
+        edgeWeights.assign(std::move(weights));
+    }
+
+    // Merges extra edges into the existing rows in one pass; places added since
+    // the last rebuild get empty rows first.
+    void addEdges(const std::vector<RouteEdge>& edges) {
+        int n = size();
+        int oldCount = static_cast<int>(edgeOffsets.size()) - 1;
+        int oldEnd = oldCount < 0 ? 0 : edgeOffsets.back();
+        auto oldOffset = [&](int u) { return u <= oldCount ? edgeOffsets[u] : oldEnd; };
+
+        std::vector<int> offsets(n + 1, 0);
+        for (auto& edge : edges) {
+            offsets[edge.from + 1]++;
+        }
+        for (int u = 0; u < n; u++) {
+            offsets[u + 1] += offsets[u];
+        }
+        for (int u = 0; u <= n; u++) {
+            offsets[u] += oldOffset(u);
+        }
+
+        std::vector<int> targets(offsets[n]);
+        std::vector<double> weights(offsets[n]);
+        std::vector<int> cursor(n);
+        for (int u = 0; u < n; u++) {
+            int out = offsets[u];
+            for (int e = oldOffset(u); e < oldOffset(u + 1); e++, out++) {
+                targets[out] = edgeTargets[e];
+                weights[out] = edgeWeights[e];
+            }
+            cursor[u] = out;
+        }
+        for (auto& edge : edges) {
+            int slot = cursor[edge.from]++;
+            targets[slot] = edge.to;
+            weights[slot] = edge.weight;
+        }
+
+        edgeOffsets.assign(std::move(offsets));
+        edgeTargets.assign(std::move(targets));
+        edgeWeights.assign(std::move(weights));
+    }
+
+    // FNV-1a hash of the adjacency, used to tell whether saved tables still match.
+    uint64_t fingerprint() const {
+        uint64_t hash = 1469598103934665603ULL;
+        auto mix = [&hash](const void* data, size_t bytes) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < bytes; i++) {
+                hash ^= p[i];
+                hash *= 1099511628211ULL;
+            }
+        };
+        int n = size();
+        mix(&n, sizeof(n));
+        mix(edgeOffsets.data(), edgeOffsets.size() * sizeof(int));
+        mix(edgeTargets.data(), edgeTargets.size() * sizeof(int));
+        mix(edgeWeights.data(), edgeWeights.size() * sizeof(double));
+        return hash;
+    }
+
+    int connectedCount() const {
+        int count = 0;
+        for (int u = 0; u + 1 < static_cast<int>(edgeOffsets.size()); u++) {
+            if (edgeOffsets[u + 1] > edgeOffsets[u]) count++;
+        }
+        return count;
+    }
+
+    // Snapshot layout (native byte order): header, then latitudes, longitudes,
+    // unitX, unitY, unitZ, edgeWeights, edgeOffsets, edgeTargets, sortedIds, nameOffsets and
+    // nameChars, each section padded to 8 bytes.
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t placeCount;
+        uint64_t edgeCount;
+        uint64_t nameBytes;
+        double linkRadiusKm;
+    };
+
+    static const uint32_t SNAPSHOT_VERSION = 2;
+
+    static size_t padded(size_t bytes) {
+        return (bytes + 7) & ~static_cast<size_t>(7);
+    }
+
+    bool saveSnapshot(const std::string& path, double linkRadiusKm) const {
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+
+            SnapshotHeader header = {{'T', 'T', 'R', 'S', 'N', 'A', 'P', '\0'}, SNAPSHOT_VERSION,
+                                     static_cast<uint32_t>(size()), edgeTargets.size(),
+                                     nameChars.size(), linkRadiusKm};
+            const char zeros[8] = {0};
+            auto section = [&](const void* data, size_t bytes) {
+                if (bytes > 0) file.write(static_cast<const char*>(data), bytes);
+                file.write(zeros, padded(bytes) - bytes);
+            };
+
+            std::vector<uint32_t> emptyNames(1, 0);
+            const uint32_t* names = nameOffsets.empty() ? emptyNames.data() : nameOffsets.data();
+            std::vector<int> emptyOffsets(1, 0);
+            const int* offsets = edgeOffsets.empty() ? emptyOffsets.data() : edgeOffsets.data();
+
+            section(&header, sizeof(header));
+            section(latitudes.data(), size() * sizeof(double));
+            section(longitudes.data(), size() * sizeof(double));
+            section(unitX.data(), size() * sizeof(double));
+            section(unitY.data(), size() * sizeof(double));
+            section(unitZ.data(), size() * sizeof(double));
+            section(edgeWeights.data(), edgeWeights.size() * sizeof(double));
+            section(offsets, (size() + 1) * sizeof(int));
+            section(edgeTargets.data(), edgeTargets.size() * sizeof(int));
+            section(sortedIds.data(), size() * sizeof(int));
+            section(names, (size() + 1) * sizeof(uint32_t));
+            section(nameChars.data(), nameChars.size());
+            if (!file.good()) return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, path, error);
+        return !error;
+    }
+
+    // True if the index arrays of a mapped snapshot can be followed without
+    // leaving their sections: CSR offsets monotone and ending at m, targets
+    // in range, sortedIds a permutation and name offsets within the chars.
+    static bool snapshotIndexesValid(size_t n, size_t m, size_t nameBytes, const int* offsets,
+                                     const int* targets, const int* sorted, const uint32_t* names) {
+        if (offsets[0] != 0 || static_cast<size_t>(offsets[n]) != m) return false;
+        for (size_t u = 0; u < n; u++) {
+            if (offsets[u + 1] < offsets[u]) return false;
+        }
+        for (size_t e = 0; e < m; e++) {
+            if (targets[e] < 0 || static_cast<size_t>(targets[e]) >= n) return false;
+        }
+        std::vector<char> seen(n, 0);
+        for (size_t i = 0; i < n; i++) {
+            if (sorted[i] < 0 || static_cast<size_t>(sorted[i]) >= n || seen[sorted[i]]) return false;
+            seen[sorted[i]] = 1;
+        }
+        if (names[0] != 0 || names[n] > nameBytes) return false;
+        for (size_t i = 0; i < n; i++) {
+            if (names[i + 1] < names[i]) return false;
+        }
+        return true;
+    }
+
+    // Maps a snapshot read-only and points every array into it; nothing is
+    // parsed or copied. Fails on a version, radius or size mismatch, or when
+    // the index arrays do not hold together (a damaged file).
+    bool loadSnapshot(const std::string& path, double linkRadiusKm) {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(path) || file->size() < sizeof(SnapshotHeader)) return false;
+
+        SnapshotHeader header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, "TTRSNAP", 8) != 0 || header.version != SNAPSHOT_VERSION ||
+            header.linkRadiusKm != linkRadiusKm) {
+            return false;
+        }
+
+        // Bounded by the file size first, so the section sizes cannot overflow.
+        if (header.placeCount > file->size() || header.edgeCount > file->size() ||
+            header.nameBytes > file->size()) return false;
+        size_t n = header.placeCount;
+        size_t m = header.edgeCount;
+        size_t expected = padded(sizeof(SnapshotHeader)) + 5 * padded(n * sizeof(double)) +
+                          padded(m * sizeof(double)) + padded((n + 1) * sizeof(int)) +
+                          padded(m * sizeof(int)) + padded(n * sizeof(int)) +
+                          padded((n + 1) * sizeof(uint32_t)) + padded(header.nameBytes);
+        if (file->size() != expected) return false;
+
+        const char* cursor = file->data() + padded(sizeof(SnapshotHeader));
+        auto take = [&cursor](size_t bytes) {
+            const char* at = cursor;
+            cursor += padded(bytes);
+            return at;
+        };
+
+        const double* lats = reinterpret_cast<const double*>(take(n * sizeof(double)));
+        const double* lons = reinterpret_cast<const double*>(take(n * sizeof(double)));
+        const double* xs = reinterpret_cast<const double*>(take(n * sizeof(double)));
+        const double* ys = reinterpret_cast<const double*>(take(n * sizeof(double)));
+        const double* zs = reinterpret_cast<const double*>(take(n * sizeof(double)));
+        const double* weights = reinterpret_cast<const double*>(take(m * sizeof(double)));
+        const int* offsets = reinterpret_cast<const int*>(take((n + 1) * sizeof(int)));
+        const int* targets = reinterpret_cast<const int*>(take(m * sizeof(int)));
+        const int* sorted = reinterpret_cast<const int*>(take(n * sizeof(int)));
+        const uint32_t* names = reinterpret_cast<const uint32_t*>(take((n + 1) * sizeof(uint32_t)));
+        const char* chars = take(header.nameBytes);
+        if (!snapshotIndexesValid(n, m, header.nameBytes, offsets, targets, sorted, names)) return false;
+
+        latitudes.borrow(lats, n);
+        longitudes.borrow(lons, n);
+        unitX.borrow(xs, n);
+        unitY.borrow(ys, n);
+        unitZ.borrow(zs, n);
+        edgeWeights.borrow(weights, m);
+        edgeOffsets.borrow(offsets, n + 1);
+        edgeTargets.borrow(targets, m);
+        sortedIds.borrow(sorted, n);
+        nameOffsets.borrow(names, n + 1);
+        nameChars.borrow(chars, header.nameBytes);
+        mapping = file;
+        return true;
+    }
+};
+
+// Uniform lat/lon grid whose cells are at least one link radius wide, so every
+// pair of places closer than the radius lies in the same or adjacent cells.
+class SpatialGrid {
+private:
+    double cellLat = 1.0;
+    double cellLon = 1.0;
+    double maxAbsLat = 0.0;
+    std::unordered_map<long long, std::vector<int>> cells;
+
+    long long cellKey(long long row, long long col) const {
+        // Shift as unsigned: row is negative south of the equator.
+        uint64_t key = (static_cast<uint64_t>(row) << 32) ^ (static_cast<uint64_t>(col) & 0xffffffffULL);
+        return static_cast<long long>(key);
+    }
+
+    long long rowOf(double lat) const { return static_cast<long long>(std::floor(lat / cellLat)); }
+    long long colOf(double lon) const { return static_cast<long long>(std::floor(lon / cellLon)); }
+
+public:
+    // Sizes the cells for radiusKm, valid for places with |lat| <= maxAbsLatitude.
+    void reset(double radiusKm, double maxAbsLatitude) {
+        const double margin = 1.0001;
+        maxAbsLat = std::min(std::fabs(maxAbsLatitude), 89.0);
+        cellLat = (radiusKm / EARTH_RADIUS_KM) / DEG_TO_RAD * margin;
+
+        // Haversine bound: sin(dLon/2) < sin(r/2R) / cos(lat) for both endpoints.
+        double s = std::sin(radiusKm / (2 * EARTH_RADIUS_KM)) / std::cos(maxAbsLat * DEG_TO_RAD);
+        cellLon = (s >= 1.0) ? 720.0 : 2 * std::asin(s) / DEG_TO_RAD * margin;
+        cellLon = std::max(cellLon, 1e-9);
+        cellLat = std::max(cellLat, 1e-9);
+        cells.clear();
+    }
+
+    bool covers(double lat) const {
+        return std::fabs(lat) <= maxAbsLat;
+    }
+
+    void insert(int id, double lat, double lon) {
+        cells[cellKey(rowOf(lat), colOf(lon))].push_back(id);
+    }
+
+    // visit(row, col, ids) for every non-empty cell.
+    template <typename Visit>
+    void forEachCell(Visit visit) const {
+        for (auto& cell : cells) {
+            long long row = cell.first >> 32;
+            long long col = static_cast<int32_t>(static_cast<uint32_t>(cell.first & 0xffffffffLL));
+            visit(row, col, cell.second);
+        }
+    }
+
+    // visit(ids) for the cell (row, col) and its eight neighbours.
+    template <typename Visit>
+    void forEachNeighbourCell(long long row, long long col, Visit visit) const {
+        for (long long r = row - 1; r <= row + 1; r++) {
+            for (long long c = col - 1; c <= col + 1; c++) {
+                auto it = cells.find(cellKey(r, c));
+                if (it != cells.end()) visit(it->second);
+            }
+        }
+    }
+
+    template <typename Visit>
+    void forEachCandidate(double lat, double lon, Visit visit) const {
+        long long row = rowOf(lat);
+        long long col = colOf(lon);
+        for (long long r = row - 1; r <= row + 1; r++) {
+            for (long long c = col - 1; c <= col + 1; c++) {
+                auto it = cells.find(cellKey(r, c));
+                if (it == cells.end()) continue;
+                for (int id : it->second) visit(id);
+            }
+        }
+    }
+};
+
+// Static k-d tree over the places' unit vectors. Chord length grows with
+// great-circle distance, so the nearest point in 3-d is the nearest stop on
+// the map. The tree is implicit: the subtree over [lo, hi) has its root at
+// the midpoint, split on the axis of widest spread, down to small leaf
+// buckets that are scanned linearly.
+class StopKdTree {
+private:
+    static const size_t LEAF_SIZE = 8;
+
+    struct Node {
+        double point[3];
+        int id;
+        int axis;
+    };
+    std::vector<Node> nodes;
+
+    void build(size_t lo, size_t hi) {
+        if (hi - lo <= LEAF_SIZE) return;
+        int axis = 0;
+        double widest = -1;
+        for (int a = 0; a < 3; a++) {
+            double low = 1e18, high = -1e18;
+            for (size_t i = lo; i < hi; i++) {
+                low = std::min(low, nodes[i].point[a]);
+                high = std::max(high, nodes[i].point[a]);
+            }
+            if (high - low > widest) {
+                widest = high - low;
+                axis = a;
+            }
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        std::nth_element(nodes.begin() + lo, nodes.begin() + mid, nodes.begin() + hi,
+                         [axis](const Node& a, const Node& b) { return a.point[axis] < b.point[axis]; });
+        nodes[mid].axis = axis;
+        build(lo, mid);
+        build(mid + 1, hi);
+    }
+
+    // best holds (chord^2, id) sorted nearest first, at most k entries.
+    void search(size_t lo, size_t hi, const double* query, size_t k,
+                std::vector<std::pair<double, int>>& best) const {
+        auto consider = [&](const Node& node) {
+            double dx = node.point[0] - query[0];
+            double dy = node.point[1] - query[1];
+            double dz = node.point[2] - query[2];
+            double chordSquared = dx * dx + dy * dy + dz * dz;
+            if (best.size() < k || chordSquared < best.back().first) {
+                if (best.size() == k) best.pop_back();
+                auto at = std::upper_bound(best.begin(), best.end(), std::make_pair(chordSquared, node.id));
+                best.insert(at, std::make_pair(chordSquared, node.id));
+            }
+        };
+        if (hi - lo <= LEAF_SIZE) {
+            for (size_t i = lo; i < hi; i++) consider(nodes[i]);
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        const Node& node = nodes[mid];
+        consider(node);
+
+        double offset = query[node.axis] - node.point[node.axis];
+        bool leftFirst = offset < 0;
+        search(leftFirst ? lo : mid + 1, leftFirst ? mid : hi, query, k, best);
+        if (best.size() < k || offset * offset < best.back().first) {
+            search(leftFirst ? mid + 1 : lo, leftFirst ? hi : mid, query, k, best);
+        }
+    }
+
+public:
+    void build(const BusNetwork& network) {
+        nodes.resize(network.size());
+        for (int id = 0; id < network.size(); id++) {
+            nodes[id] = Node{{network.unitX[id], network.unitY[id], network.unitZ[id]}, id, 0};
+        }
+        build(0, nodes.size());
+    }
+
+    int size() const { return static_cast<int>(nodes.size()); }
+
+    // Up to k places nearest to (lat, lon) as (km, id), nearest first.
+    void nearest(double lat, double lon, size_t k, std::vector<std::pair<double, int>>& found) const {
+        double query[3];
+        BusNetwork::unitVector(lat, lon, query[0], query[1], query[2]);
+        found.clear();
+        if (k == 0) return;
+        found.reserve(k + 1);
+        search(0, nodes.size(), query, k, found);
+        for (auto& entry : found) entry.first = GeoKernel::chordToKm(entry.first);
+    }
+};
+
+// Contraction Hierarchies over the (symmetric) bus network. Places are
+// contracted in edge-difference order; shortcuts remember the place they
+// bypass so query results can be unpacked back into original stops. The
+// upward graph is numbered by rank, so the top of the hierarchy that every
+// query climbs into sits together in memory.
+class ContractionHierarchy {
+private:
+    struct Arc {
+        int to;
+        int middle;     // -1 for an original edge
+        double weight;
+    };
+
+    struct Point {
+        double x, y, z;     // unit vector, as in BusNetwork
+    };
+
+    std::vector<int> rank;          // place id -> rank
+    std::vector<int> placeOf;       // rank -> place id
+    std::vector<Point> points;      // by rank
+    std::vector<int> upOffsets;
+    std::vector<int> upTargets;
+    std::vector<int> upMiddles;
+    std::vector<double> upWeights;
+    int shortcutCount = 0;
+    double buildMillis = 0.0;
+    bool ready = false;
+
+    // Arc lists are kept shortest first, so a witness search can stop
+    // scanning a place at the first arc that overshoots its limit.
+    static void addArc(std::vector<Arc>& arcs, int to, double weight, int middle) {
+        for (size_t k = 0; k < arcs.size(); k++) {
+            if (arcs[k].to == to) {
+                if (weight >= arcs[k].weight) return;
+                arcs.erase(arcs.begin() + k);
+                break;
+            }
+        }
+        auto at = std::upper_bound(arcs.begin(), arcs.end(), weight,
+                                   [](double w, const Arc& arc) { return w < arc.weight; });
+        arcs.insert(at, Arc{to, middle, weight});
+    }
+
+    // Straight-line lower bound between two ranks, as chordLowerBound.
+    double lowerBound(int a, int b) const {
+        double dx = points[a].x - points[b].x;
+        double dy = points[a].y - points[b].y;
+        double dz = points[a].z - points[b].z;
+        return EARTH_RADIUS_KM * std::sqrt(dx * dx + dy * dy + dz * dz) * (1.0 - 1e-9);
+    }
+
+    // a and b are ranks, as are the upward arcs and their middles.
+    int middleOf(int a, int b) const {
+        int low = std::min(a, b);
+        int high = std::max(a, b);
+        for (int e = upOffsets[low]; e < upOffsets[low + 1]; e++) {
+            if (upTargets[e] == high) return upMiddles[e];
+        }
+        return -1;
+    }
+
+    // Appends the original stops after a on the arc a-b (b included).
+    void unpack(int a, int b, int middle, std::vector<int>& path) const {
+        if (middle < 0) {
+            path.push_back(placeOf[b]);
+            return;
+        }
+        unpack(a, middle, middleOf(a, middle), path);
+        unpack(middle, b, middleOf(middle, b), path);
+    }
+
+public:
+    bool isReady() const { return ready; }
+    int getShortcutCount() const { return shortcutCount; }
+    double getBuildMillis() const { return buildMillis; }
+
+    void clear() {
+        ready = false;
+        rank.clear();
+        placeOf.clear();
+        points.clear();
+        upOffsets.clear();
+        upTargets.clear();
+        upMiddles.clear();
+        upWeights.clear();
+        shortcutCount = 0;
+    }
+
+    void build(const BusNetwork& network) {
+        auto started = std::chrono::steady_clock::now();
+        int n = network.size();
+        std::vector<std::vector<Arc>> adj(n);
+        for (int u = 0; u < n; u++) {
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                addArc(adj[u], network.edgeTargets[e], network.edgeWeights[e], -1);
+            }
+        }
+
+        std::vector<char> contracted(n, 0);
+        std::vector<int> deletedNeighbours(n, 0);
+        std::vector<int> level(n, 0);
+        std::vector<double> witnessDist(n, 1e18);
+        std::vector<int> witnessHops(n, 0);
+        std::vector<int> targetOf(n, -1);       // search that still needs a witness to this place
+        std::vector<double> viaWeight(n, 0.0);  // length of the route through v it must beat
+        std::vector<int> openTargets;
+        int searchCount = 0;
+        std::vector<int> touched;
+        std::vector<std::pair<double, int>> witnessHeap;
+        const int maxWitnessSettled = 500;
+        const int maxWitnessHops = 5;
+
+        // Local Dijkstra from source that ignores `skip`, going at most a few
+        // hops and a few hundred places out. A target is done once it is
+        // reached within its viaWeight (witnessed, and unmarked) or settled
+        // beyond it; the search stops when none is left, and never looks
+        // further than the longest viaWeight still open. A witness it misses
+        // only costs a redundant shortcut.
+        auto witnessSearch = [&](int source, int skip) {
+            using Pair = std::pair<double, int>;
+            int targets = static_cast<int>(openTargets.size());
+            size_t last = openTargets.size() - 1;   // openTargets is by viaWeight
+            double limit = viaWeight[openTargets[last]];
+            witnessHeap.clear();
+            witnessDist[source] = 0;
+            witnessHops[source] = 0;
+            touched.push_back(source);
+            witnessHeap.push_back(std::make_pair(0.0, source));
+            int settledCount = 0;
+            while (!witnessHeap.empty() && settledCount < maxWitnessSettled) {
+                std::pop_heap(witnessHeap.begin(), witnessHeap.end(), std::greater<Pair>());
+                double d = witnessHeap.back().first;
+                int u = witnessHeap.back().second;
+                witnessHeap.pop_back();
+                if (d > witnessDist[u]) continue;
+                if (d > limit) break;
+                settledCount++;
+                if (targetOf[u] == searchCount && --targets == 0) break;
+                if (witnessHops[u] >= maxWitnessHops) continue;
+                // Places at the hop limit are never expanded, so they only
+                // need a distance, not a heap entry.
+                int hops = witnessHops[u] + 1;
+                for (auto& arc : adj[u]) {
+                    double nd = d + arc.weight;
+                    if (nd > limit) break;
+                    if (arc.to != skip && nd < witnessDist[arc.to]) {
+                        if (witnessDist[arc.to] >= 1e18) touched.push_back(arc.to);
+                        witnessDist[arc.to] = nd;
+                        witnessHops[arc.to] = hops;
+                        if (targetOf[arc.to] == searchCount && nd <= viaWeight[arc.to]) {
+                            targetOf[arc.to] = -1;
+                            if (--targets == 0) return;
+                            while (targetOf[openTargets[last]] != searchCount) last--;
+                            limit = viaWeight[openTargets[last]];
+                        }
+                        if (hops < maxWitnessHops) {
+                            witnessHeap.push_back(std::make_pair(nd, arc.to));
+                            std::push_heap(witnessHeap.begin(), witnessHeap.end(), std::greater<Pair>());
+                        }
+                    }
+                }
+            }
+        };
+
+        // Counts (and optionally inserts) the shortcuts needed to remove v.
+        // Ranking only trusts direct arcs as witnesses; inserting runs the
+        // witness search too. adj[] of a live place only lists live
+        // neighbours, and inserting a shortcut never touches adj[v] itself.
+        auto contract = [&](int v, bool apply) {
+            const std::vector<Arc>& neighbours = adj[v];
+            int shortcuts = 0;
+            for (size_t i = 0; i + 1 < neighbours.size(); i++) {
+                searchCount++;
+                for (size_t j = i + 1; j < neighbours.size(); j++) {
+                    targetOf[neighbours[j].to] = searchCount;
+                    viaWeight[neighbours[j].to] = neighbours[i].weight + neighbours[j].weight;
+                }
+
+                // Pairs witnessed by a direct arc need no search at all.
+                for (auto& arc : adj[neighbours[i].to]) {
+                    if (targetOf[arc.to] == searchCount && arc.weight <= viaWeight[arc.to]) targetOf[arc.to] = -1;
+                }
+                openTargets.clear();
+                for (size_t j = i + 1; j < neighbours.size(); j++) {
+                    if (targetOf[neighbours[j].to] == searchCount) openTargets.push_back(neighbours[j].to);
+                }
+                if (apply && !openTargets.empty()) witnessSearch(neighbours[i].to, v);
+
+                for (size_t j = i + 1; j < neighbours.size(); j++) {
+                    double weight = neighbours[i].weight + neighbours[j].weight;
+                    if (targetOf[neighbours[j].to] != searchCount || witnessDist[neighbours[j].to] <= weight) continue;
+                    shortcuts++;
+                    if (apply) {
+                        addArc(adj[neighbours[i].to], neighbours[j].to, weight, v);
+                        addArc(adj[neighbours[j].to], neighbours[i].to, weight, v);
+                    }
+                }
+                for (int t : touched) witnessDist[t] = 1e18;
+                touched.clear();
+            }
+            return static_cast<int>(shortcuts - neighbours.size());
+        };
+
+        // Edge difference from the cheap witness check, plus deleted
+        // neighbours and level so contraction spreads evenly over the city.
+        auto priorityOf = [&](int v) {
+            return contract(v, false) + deletedNeighbours[v] + level[v];
+        };
+
+        // Queue entries whose priority is out of date are skipped when popped.
+        using Entry = std::pair<int, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> order;
+        std::vector<int> priority(n);
+        for (int v = 0; v < n; v++) {
+            priority[v] = priorityOf(v);
+            order.push(std::make_pair(priority[v], v));
+        }
+
+        rank.assign(n, 0);
+        int nextRank = 0;
+        while (!order.empty()) {
+            int v = order.top().second;
+            int queued = order.top().first;
+            order.pop();
+            if (contracted[v] || queued != priority[v]) continue;
+
+            // Lazy update: re-evaluate and requeue if it is no longer the best.
+            priority[v] = priorityOf(v);
+            if (!order.empty() && priority[v] > order.top().first) {
+                order.push(std::make_pair(priority[v], v));
+                continue;
+            }
+
+            contract(v, true);
+            contracted[v] = 1;
+            rank[v] = nextRank++;
+
+            // adj[v] is kept as is for the upward graph; only v's neighbours
+            // lose an arc. Their priorities are not recomputed here: the
+            // re-check at pop catches every one that went up.
+            for (auto& arc : adj[v]) {
+                std::vector<Arc>& back = adj[arc.to];
+                for (size_t k = 0; k < back.size(); k++) {
+                    if (back[k].to == v) {
+                        back.erase(back.begin() + k);
+                        break;
+                    }
+                }
+                deletedNeighbours[arc.to]++;
+                level[arc.to] = std::max(level[arc.to], level[v] + 1);
+            }
+        }
+
+        // Keep only arcs that lead to higher-ranked places, laid out by rank.
+        placeOf.assign(n, 0);
+        points.assign(n, Point{0, 0, 0});
+        for (int v = 0; v < n; v++) {
+            placeOf[rank[v]] = v;
+            points[rank[v]] = Point{network.unitX[v], network.unitY[v], network.unitZ[v]};
+        }
+        upOffsets.assign(n + 1, 0);
+        upTargets.clear();
+        upMiddles.clear();
+        upWeights.clear();
+        shortcutCount = 0;
+        for (int r = 0; r < n; r++) {
+            for (auto& arc : adj[placeOf[r]]) {
+                if (rank[arc.to] <= r) continue;
+                upTargets.push_back(rank[arc.to]);
+                upWeights.push_back(arc.weight);
+                upMiddles.push_back(arc.middle < 0 ? -1 : rank[arc.middle]);
+                if (arc.middle >= 0) shortcutCount++;
+            }
+            upOffsets[r + 1] = static_cast<int>(upTargets.size());
+        }
+
+        buildMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        ready = true;
+    }
+
+    // Bidirectional upward search; both directions use the same upward arcs
+    // because the network is symmetric. Labels are kept per rank, heap is the
+    // workspace pair picked by --heap, and the unpacked route of place ids
+    // goes into path.
+    template <typename Heap>
+    void query(int start, int end, SearchWorkspace& workspace, Heap* heap, std::vector<int>& path,
+               SearchStats& stats) const {
+        int n = static_cast<int>(rank.size());
+        SearchLabels* labels = workspace.labels;
+        for (int side = 0; side < 2; side++) {
+            labels[side].reset(n);
+            heap[side].clear();
+        }
+        int source = rank[start];
+        int target = rank[end];
+        int goal[2] = {target, source};
+        // Keys are distance plus the straight line to the other end. Every
+        // upward arc is at least as long as its straight line, so the bound
+        // is consistent and places still settle at their exact distance.
+        auto estimate = [&](int s, int v) {
+            double& cached = labels[s].estimate(v);
+            if (cached < 0) cached = lowerBound(v, goal[s]);
+            return cached;
+        };
+        labels[0].update(source, 0, -1);
+        labels[1].update(target, 0, -1);
+        heap[0].push(estimate(0, source), source);
+        heap[1].push(estimate(1, target), target);
+
+        double best = (start == end) ? 0.0 : 1e18;
+        int meet = (start == end) ? source : -1;
+        int side = 0;
+
+        while (!heap[0].empty() || !heap[1].empty()) {
+            // A key bounds every route through its place, so a side whose
+            // smallest key reaches best can add nothing.
+            if (heap[side].empty() || heap[side].topKey() >= best) {
+                heap[side].clear();
+                side = 1 - side;
+                continue;
+            }
+
+            double key;
+            int u;
+            heap[side].pop(key, u);
+            if (labels[side].settled(u)) continue;
+            labels[side].settle(u);
+            double d = labels[side].distance(u);
+            stats.settledNodes++;
+
+            // Stall-on-demand: a higher place on this side already reaches u
+            // more cheaply, so nothing found through u can be shortest.
+            bool stalled = false;
+            for (int e = upOffsets[u]; e < upOffsets[u + 1] && !stalled; e++) {
+                stalled = labels[side].distance(upTargets[e]) + upWeights[e] < d;
+            }
+            if (stalled) {
+                side = 1 - side;
+                continue;
+            }
+
+            // The top of the best route is settled exactly from both sides,
+            // so meetings only need checking here, not on every arc.
+            double through = d + labels[1 - side].distance(u);
+            if (through < best) {
+                best = through;
+                meet = u;
+            }
+
+            for (int e = upOffsets[u]; e < upOffsets[u + 1]; e++) {
+                int v = upTargets[e];
+                stats.relaxedEdges++;
+                double dv = d + upWeights[e];
+                if (dv < labels[side].distance(v)) {
+                    labels[side].update(v, dv, u, e);
+                    double vkey = dv + estimate(side, v);
+                    if (vkey < best) heap[side].push(vkey, v);
+                }
+            }
+            side = 1 - side;
+        }
+
+        path.clear();
+        if (meet < 0) {
+            return;
+        }
+
+        std::vector<int>& upChain = workspace.chain;
+        labels[0].tracePath(meet, upChain);
+
+        path.push_back(start);
+        for (size_t i = 1; i < upChain.size(); i++) {
+            unpack(upChain[i - 1], upChain[i], upMiddles[labels[0].arc(upChain[i])], path);
+        }
+        for (int v = meet; labels[1].parent(v) != -1; v = labels[1].parent(v)) {
+            unpack(v, labels[1].parent(v), upMiddles[labels[1].arc(v)], path);
+        }
+    }
+};
+
+// Landmark distance tables for ALT search. On a symmetric graph the triangle
+// inequality gives |d(L, t) - d(L, v)| <= d(v, t) for every landmark L.
+class LandmarkTable {
+private:
+    int placeCount = 0;
+    uint64_t graphFingerprint = 0;
+    std::vector<int> landmarks;
+    std::vector<double> distances;      // distances[i * placeCount + v]
+
+public:
+    bool isReady() const { return !landmarks.empty(); }
+    int landmarkCount() const { return static_cast<int>(landmarks.size()); }
+    const std::vector<int>& getLandmarks() const { return landmarks; }
+
+    void clear() {
+        placeCount = 0;
+        graphFingerprint = 0;
+        landmarks.clear();
+        distances.clear();
+    }
+
+    void reset(int places, uint64_t fingerprint) {
+        clear();
+        placeCount = places;
+        graphFingerprint = fingerprint;
+    }
+
+    void addLandmark(int id, const std::vector<double>& dist) {
+        landmarks.push_back(id);
+        distances.insert(distances.end(), dist.begin(), dist.end());
+    }
+
+    double lowerBound(int v, int target) const {
+        double bound = 0.0;
+        for (size_t i = 0; i < landmarks.size(); i++) {
+            const double* row = &distances[i * placeCount];
+            if (row[v] >= 1e18 || row[target] >= 1e18) continue;
+            bound = std::max(bound, std::fabs(row[target] - row[v]));
+        }
+        return bound;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        const char magic[8] = {'T', 'T', 'R', 'A', 'L', 'T', '0', '1'};
+        int count = landmarkCount();
+        file.write(magic, sizeof(magic));
+        file.write(reinterpret_cast<const char*>(&graphFingerprint), sizeof(graphFingerprint));
+        file.write(reinterpret_cast<const char*>(&placeCount), sizeof(placeCount));
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        file.write(reinterpret_cast<const char*>(landmarks.data()), count * sizeof(int));
+        file.write(reinterpret_cast<const char*>(distances.data()), distances.size() * sizeof(double));
+        return file.good();
+    }
+
+    // Loads a saved table only if it was built for the same graph.
+    bool load(const std::string& path, int places, uint64_t fingerprint) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        char magic[8];
+        uint64_t savedFingerprint = 0;
+        int savedPlaces = 0;
+        int count = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&savedFingerprint), sizeof(savedFingerprint));
+        file.read(reinterpret_cast<char*>(&savedPlaces), sizeof(savedPlaces));
+        file.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!file || std::string(magic, 8) != "TTRALT01" || savedFingerprint != fingerprint ||
+            savedPlaces != places || count <= 0 || count > places) {
+            return false;
+        }
+
+        std::vector<int> savedLandmarks(count);
+        std::vector<double> savedDistances(static_cast<size_t>(count) * places);
+        file.read(reinterpret_cast<char*>(savedLandmarks.data()), count * sizeof(int));
+        file.read(reinterpret_cast<char*>(savedDistances.data()), savedDistances.size() * sizeof(double));
+        if (!file) return false;
+
+        placeCount = places;
+        graphFingerprint = fingerprint;
+        landmarks.swap(savedLandmarks);
+        distances.swap(savedDistances);
+        return true;
+    }
+};
+
+// Hour-of-day congestion as piecewise-linear multipliers of free-flow travel
+// time. Every road class shares one breakpoint table; times are minutes after
+// midnight and wrap around every day.
+class TrafficProfiles {
+public:
+    enum Profile : uint8_t { Core, Ring, Outer, FreeFlow, PROFILE_COUNT };
+    static const int BREAKPOINTS = 11;
+
+private:
+    static constexpr double breakpoints[BREAKPOINTS] = {
+        0, 360, 480, 600, 660, 990, 1020, 1140, 1200, 1380, 1440};
+    static constexpr double factors[PROFILE_COUNT][BREAKPOINTS] = {
+        {1.0, 1.0, 1.7, 1.7, 1.3, 1.3, 1.7, 1.7, 1.3, 1.0, 1.0},       // city core
+        {1.0, 1.0, 1.4, 1.4, 1.2, 1.2, 1.4, 1.4, 1.2, 1.0, 1.0},       // middle ring
+        {1.0, 1.0, 1.15, 1.15, 1.05, 1.05, 1.15, 1.15, 1.05, 1.0, 1.0}, // outskirts
+        {1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0}};
+
+public:
+    static const char* name(int profile) {
+        static const char* names[PROFILE_COUNT] = {"core", "ring", "outer", "free-flow"};
+        return names[profile];
+    }
+
+    static double factor(int profile, double minute) {
+        double t = std::fmod(minute, 1440.0);
+        if (t < 0) t += 1440.0;
+        int i = 1;
+        while (i < BREAKPOINTS - 1 && breakpoints[i] <= t) i++;
+        const double* f = factors[profile];
+        double share = (t - breakpoints[i - 1]) / (breakpoints[i] - breakpoints[i - 1]);
+        return f[i - 1] + (f[i] - f[i - 1]) * share;
+    }
+
+    // Fastest fall of the multiplier, per minute. An edge of free-flow time b
+    // is FIFO (entering later never means leaving earlier) iff b * drop <= 1.
+    static double steepestDrop(int profile) {
+        double drop = 0;
+        for (int i = 1; i < BREAKPOINTS; i++) {
+            double fall = factors[profile][i - 1] - factors[profile][i];
+            drop = std::max(drop, fall / (breakpoints[i] - breakpoints[i - 1]));
+        }
+        return drop;
+    }
+};
+
+// Road class of every edge, taken from how far the edge lies from the middle
+// of the network: the inner 30% of places is the core, the next 40% the ring.
+// An edge too long for its profile to stay FIFO is treated as free-flow.
+class TrafficModel {
+private:
+    std::vector<uint8_t> edgeProfiles;
+    int profileCounts[TrafficProfiles::PROFILE_COUNT] = {};
+
+public:
+    void build(const BusNetwork& network) {
+        int n = network.size();
+        edgeProfiles.assign(network.edgeTargets.size(), TrafficProfiles::FreeFlow);
+        std::fill(std::begin(profileCounts), std::end(profileCounts), 0);
+        if (n == 0) return;
+
+        double midLat = 0, midLon = 0;
+        for (int v = 0; v < n; v++) {
+            midLat += network.latitudes[v];
+            midLon += network.longitudes[v];
+        }
+        midLat /= n;
+        midLon /= n;
+
+        std::vector<double> fromMiddle(n);
+        for (int v = 0; v < n; v++) {
+            double dLat = network.latitudes[v] - midLat;
+            double dLon = (network.longitudes[v] - midLon) * std::cos(midLat * DEG_TO_RAD);
+            fromMiddle[v] = dLat * dLat + dLon * dLon;
+        }
+        std::vector<double> sorted = fromMiddle;
+        std::nth_element(sorted.begin(), sorted.begin() + n * 3 / 10, sorted.end());
+        double coreLimit = sorted[n * 3 / 10];
+        std::nth_element(sorted.begin(), sorted.begin() + n * 7 / 10, sorted.end());
+        double ringLimit = sorted[n * 7 / 10];
+
+        for (int u = 0; u < n; u++) {
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                int v = network.edgeTargets[e];
+                double middle = std::max(fromMiddle[u], fromMiddle[v]);
+                int profile = middle <= coreLimit ? TrafficProfiles::Core
+                            : middle <= ringLimit ? TrafficProfiles::Ring : TrafficProfiles::Outer;
+                double freeFlow = (network.edgeWeights[e] / 20.0) * 60;
+                if (freeFlow * TrafficProfiles::steepestDrop(profile) > 1.0) profile = TrafficProfiles::FreeFlow;
+                edgeProfiles[e] = static_cast<uint8_t>(profile);
+                profileCounts[profile]++;
+            }
+        }
+    }
+
+    int profileOf(int e) const { return edgeProfiles[e]; }
+    int edgeCount(int profile) const { return profileCounts[profile]; }
+
+    // Minutes to ride edge e when boarding at the given minute of the day.
+    double travelMinutes(const BusNetwork& network, int e, double minute) const {
+        return (network.edgeWeights[e] / 20.0) * 60 * TrafficProfiles::factor(edgeProfiles[e], minute);
+    }
+};
+
+// Fixed set of worker threads that share out the indices of a job. The
+// calling thread takes part as worker 0.
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(int, int)>* job = nullptr;
+    std::atomic<int> nextIndex{0};
+    int jobSize = 0;
+    int busyWorkers = 0;
+    long long generation = 0;
+    bool stopping = false;
+
+    void drain(int worker) {
+        for (int i = nextIndex.fetch_add(1); i < jobSize; i = nextIndex.fetch_add(1)) {
+            (*job)(i, worker);
+        }
+    }
+
+    void workerLoop(int worker) {
+        long long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            drain(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busyWorkers == 0) finished.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit WorkerPool(int workers) {
+        for (int w = 1; w < std::max(workers, 1); w++) {
+            threads.emplace_back(&WorkerPool::workerLoop, this, w);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    int size() const {
+        return static_cast<int>(threads.size()) + 1;
+    }
+
+    // Runs body(index, worker) for every index in [0, count) and waits.
+    void parallelFor(int count, const std::function<void(int, int)>& body) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &body;
+            jobSize = count;
+            nextIndex = 0;
+            busyWorkers = static_cast<int>(threads.size());
+            generation++;
+        }
+        wake.notify_all();
+        drain(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+};
+
+// Epoch-based reclamation for objects published through an atomic pointer.
+// A reader announces the epoch it entered in its own slot before loading the
+// pointer; the writer swaps the pointer, advances the epoch and frees the old
+// object only once every announced epoch is newer than its retirement.
+// Readers never take a lock and never wait for the writer.
+class EpochDomain {
+private:
+    static const int MAX_READERS = 256;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> pinned{0};    // entry epoch, 0 when idle
+        std::atomic<bool> taken{false};
+    };
+
+    // A thread keeps its slot until it exits; nested pins reuse the outer one.
+    // Threads that find every slot taken are counted in overflowReaders
+    // instead of waiting for one to free up.
+    struct Registration {
+        EpochDomain* domain = nullptr;
+        int slot = -1;
+        int depth = 0;
+        bool overflow = false;      // the outermost pin went through overflowReaders
+
+        ~Registration() {
+            if (slot >= 0) domain->slots[slot].taken.store(false, std::memory_order_release);
+        }
+    };
+
+    Slot slots[MAX_READERS];
+    std::atomic<uint64_t> epoch{1};
+    alignas(64) std::atomic<int> overflowReaders{0};
+
+    static Registration& registration() {
+        thread_local Registration local;
+        return local;
+    }
+
+    // Claims a free slot for a thread that has none; false if all are taken.
+    bool claimSlot(Registration& self) {
+        for (int i = 0; i < MAX_READERS; i++) {
+            bool expected = false;
+            if (!slots[i].taken.load(std::memory_order_relaxed) &&
+                slots[i].taken.compare_exchange_strong(expected, true)) {
+                self.domain = this;
+                self.slot = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    static EpochDomain& global() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void enter() {
+        Registration& self = registration();
+        if (self.depth++ != 0) return;
+        self.overflow = self.slot < 0 && !claimSlot(self);
+        if (self.overflow) {
+            overflowReaders.fetch_add(1);
+        } else {
+            slots[self.slot].pinned.store(epoch.load());
+        }
+    }
+
+    void exit() {
+        Registration& self = registration();
+        if (--self.depth != 0) return;
+        if (self.overflow) {
+            overflowReaders.fetch_sub(1, std::memory_order_release);
+        } else {
+            slots[self.slot].pinned.store(0, std::memory_order_release);
+        }
+    }
+
+    // Called by the writer right after unpublishing an object; returns the
+    // epoch it was retired in.
+    uint64_t retire() {
+        return epoch.fetch_add(1);
+    }
+
+    // Objects retired before this epoch can no longer be reached by a reader.
+    // Overflow readers do not record an epoch, so while any is pinned nothing
+    // counts as unreachable.
+    uint64_t oldestPinned() const {
+        if (overflowReaders.load() != 0) return 0;
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const Slot& slot : slots) {
+            uint64_t pinned = slot.pinned.load();
+            if (pinned != 0) oldest = std::min(oldest, pinned);
+        }
+        return oldest;
+    }
+};
+
+// Single-writer publication of immutable versions of T. Readers pin() the
+// current version for as long as they use it; publish() swaps in the next
+// one and frees retired versions that no reader can still hold.
+template <typename T>
+class SnapshotPublisher {
+private:
+    std::atomic<const T*> current{nullptr};
+    std::vector<std::pair<uint64_t, const T*>> retired;    // writer only
+
+public:
+    class Pin {
+    private:
+        const T* value;
+
+    public:
+        explicit Pin(const std::atomic<const T*>& source) {
+            EpochDomain::global().enter();
+            value = source.load();
+        }
+        ~Pin() { EpochDomain::global().exit(); }
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+
+        const T& operator*() const { return *value; }
+        const T* operator->() const { return value; }
+    };
+
+    SnapshotPublisher() = default;
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    ~SnapshotPublisher() {
+        delete current.load();
+        for (auto& item : retired) delete item.second;
+    }
+
+    Pin pin() const { return Pin(current); }
+
+    void publish(std::unique_ptr<const T> next) {
+        const T* old = current.exchange(next.release());
+        if (old) retired.push_back(std::make_pair(EpochDomain::global().retire(), old));
+        reclaim();
+    }
+
+    void reclaim() {
+        uint64_t oldest = EpochDomain::global().oldestPinned();
+        size_t kept = 0;
+        for (auto& item : retired) {
+            if (item.first < oldest) {
+                delete item.second;
+            } else {
+                retired[kept++] = item;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    size_t retiredCount() const { return retired.size(); }
+};
+
+// Log-linear latency buckets in the spirit of HdrHistogram: 32 linear
+// sub-buckets per power of two keep every value within about 3%.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKETS = SUB_COUNT * (64 - SUB_BITS + 1);
+
+private:
+    std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS, 0);
+    uint64_t total = 0;
+    uint64_t largest = 0;
+    double sum = 0;
+
+public:
+    static int bucketOf(uint64_t value) {
+        if (value < static_cast<uint64_t>(SUB_COUNT)) return static_cast<int>(value);
+#if defined(__GNUC__)
+        int msb = 63 - __builtin_clzll(value);
+#else
+        int msb = 0;
+        while (value >> (msb + 1)) msb++;
+#endif
+        int shift = msb - SUB_BITS;
+        return SUB_COUNT * (shift + 1) + static_cast<int>((value >> shift) - SUB_COUNT);
+    }
+
+    // Largest value that lands in the bucket.
+    static uint64_t highestIn(int bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+        int shift = bucket / SUB_COUNT - 1;
+        uint64_t mantissa = SUB_COUNT + bucket % SUB_COUNT;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    void add(int bucket, uint64_t count) {
+        counts[bucket] += count;
+        total += count;
+        sum += static_cast<double>(highestIn(bucket)) * count;
+    }
+
+    void noteMax(uint64_t value) { largest = std::max(largest, value); }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return largest; }
+    double mean() const { return total ? sum / total : 0.0; }
+
+    // Value at or below which the fraction q of recordings fall.
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * total));
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += counts[b];
+            if (seen >= std::max<uint64_t>(rank, 1)) return std::min(highestIn(b), largest);
+        }
+        return largest;
+    }
+};
+
+// Process-wide latency histograms per phase plus event counters. Each thread
+// records into its own shard with relaxed stores and never locks after its
+// first recording; readers merge all shards.
+class Metrics {
+public:
+    enum Phase { Load, Build, Query, Fare, PHASE_COUNT };
+    enum Counter { SettledNodes, RelaxedEdges, CacheHits, CacheMisses, COUNTER_COUNT };
+
+    struct Summary {
+        LatencyHistogram phases[PHASE_COUNT];
+        uint64_t counters[COUNTER_COUNT] = {};
+    };
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> buckets[PHASE_COUNT][LatencyHistogram::BUCKETS];
+        std::atomic<uint64_t> largest[PHASE_COUNT];
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+
+        Shard() {
+            for (auto& phase : buckets) {
+                for (auto& bucket : phase) bucket.store(0, std::memory_order_relaxed);
+            }
+            for (auto& value : largest) value.store(0, std::memory_order_relaxed);
+            for (auto& value : counters) value.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    // Only the owning thread writes a slot, so load + store needs no RMW.
+    static void bump(std::atomic<uint64_t>& slot, uint64_t by) {
+        slot.store(slot.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Shards outlive their threads so nothing recorded is lost.
+    static std::vector<std::unique_ptr<Shard>>& shards() {
+        static std::vector<std::unique_ptr<Shard>> all;
+        return all;
+    }
+
+    static Shard& local() {
+        thread_local Shard* shard = nullptr;
+        if (!shard) {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            shards().emplace_back(new Shard());
+            shard = shards().back().get();
+        }
+        return *shard;
+    }
+
+public:
+    static const char* phaseName(int phase) {
+        static const char* names[PHASE_COUNT] = {"load", "build", "query", "fare"};
+        return names[phase];
+    }
+
+    static const char* counterName(int counter) {
+        static const char* names[COUNTER_COUNT] = {"settled_nodes", "relaxed_edges", "cache_hits", "cache_misses"};
+        return names[counter];
+    }
+
+    static void record(Phase phase, uint64_t nanos) {
+        Shard& shard = local();
+        bump(shard.buckets[phase][LatencyHistogram::bucketOf(nanos)], 1);
+        if (nanos > shard.largest[phase].load(std::memory_order_relaxed)) {
+            shard.largest[phase].store(nanos, std::memory_order_relaxed);
+        }
+    }
+
+    static void add(Counter counter, uint64_t by) {
+        bump(local().counters[counter], by);
+    }
+
+    static Summary collect() {
+        Summary summary;
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (const auto& shard : shards()) {
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+                    uint64_t count = shard->buckets[p][b].load(std::memory_order_relaxed);
+                    if (count) summary.phases[p].add(b, count);
+                }
+                summary.phases[p].noteMax(shard->largest[p].load(std::memory_order_relaxed));
+            }
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                summary.counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+        }
+        return summary;
+    }
+};
+
+// Records the time until it goes out of scope under one phase.
+class PhaseTimer {
+private:
+    Metrics::Phase phase;
+    std::chrono::steady_clock::time_point started;
+
+public:
+    explicit PhaseTimer(Metrics::Phase timedPhase)
+        : phase(timedPhase), started(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        Metrics::record(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+// Appends the merged metrics to a file every interval (and once more on
+// shutdown) as logfmt lines, one per phase and per counter, so an external
+// scraper can tail the file.
+class MetricsDumper {
+private:
+    std::string path;
+    std::chrono::seconds interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+    void dump() {
+        std::ofstream out(path, std::ios::app);
+        if (!out.is_open()) return;
+        long long now = static_cast<long long>(time(NULL));
+        Metrics::Summary summary = Metrics::collect();
+        out << std::fixed << std::setprecision(3);
+        for (int p = 0; p < Metrics::PHASE_COUNT; p++) {
+            const LatencyHistogram& h = summary.phases[p];
+            out << "ts=" << now << " phase=" << Metrics::phaseName(p) << " count=" << h.count()
+                << " p50_us=" << h.percentile(0.50) / 1e3 << " p99_us=" << h.percentile(0.99) / 1e3
+                << " p999_us=" << h.percentile(0.999) / 1e3 << " max_us=" << h.max() / 1e3
+                << " mean_us=" << h.mean() / 1e3 << "\n";
+        }
+        for (int c = 0; c < Metrics::COUNTER_COUNT; c++) {
+            out << "ts=" << now << " counter=" << Metrics::counterName(c) << " value=" << summary.counters[c] << "\n";
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (!wake.wait_for(lock, interval, [&] { return stopping; })) dump();
+        }
+    }
+
+public:
+    MetricsDumper(const std::string& file, int seconds)
+        : path(file), interval(std::max(seconds, 1)), thread(&MetricsDumper::run, this) {}
+
+    ~MetricsDumper() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+        dump();
+    }
+};
+
+// Row-major origin x destination results: entry (i, j) is at i * cols + j.
+struct DistanceMatrix {
+    int rows = 0;
+    int cols = 0;
+    std::vector<double> distanceKm;
+    std::vector<double> travelMinutes;
+};
+
+// One row of a batch job; ids are -1 for stop names that were not found and
+// departMinute is -1 when the row asks for the shortest rather than the
+// fastest route.
+struct BatchQuery {
+    int start;
+    int end;
+    bool student;
+    double departMinute;
+};
+
+// Answer for one BatchQuery; stops is 0 when there is no route.
+struct BatchResult {
+    int stops = 0;
+    double distanceKm = 0;
+    double travelMinutes = 0;
+    double fare = 0;
+};
+
+// Text collected in one reusable buffer and handed to the OS with a single
+// write per flush. Numbers are formatted with std::to_chars, so nothing is
+// allocated per value and the stream's locale and flags do not apply. A null
+// stream formats as usual but discards every flush.
+class OutputBuffer {
+private:
+    std::FILE* file;
+    bool owned;
+    std::vector<char> data;
+    size_t used = 0;
+
+    char* reserve(size_t bytes) {
+        if (used + bytes > data.size()) {
+            flush();
+            if (bytes > data.size()) data.resize(bytes);
+        }
+        return data.data() + used;
+    }
+
+    void pad(size_t written, size_t width) {
+        if (written < width) repeat(' ', width - written);
+    }
+
+public:
+    static const size_t CAPACITY = 1 << 16;
+
+    explicit OutputBuffer(std::FILE* stream) : file(stream), owned(false), data(CAPACITY) {}
+    explicit OutputBuffer(const std::string& path)
+        : file(std::fopen(path.c_str(), "wb")), owned(true), data(CAPACITY) {}
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    ~OutputBuffer() {
+        flush();
+        if (owned && file) std::fclose(file);
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    OutputBuffer& put(char c) {
+        *reserve(1) = c;
+        used++;
+        return *this;
+    }
+
+    OutputBuffer& repeat(char c, size_t count) {
+        std::memset(reserve(count), c, count);
+        used += count;
+        return *this;
+    }
+
+    // Left-aligned in width bytes, like std::left << std::setw(width).
+    OutputBuffer& text(std::string_view value, size_t width = 0) {
+        std::memcpy(reserve(value.size()), value.data(), value.size());
+        used += value.size();
+        pad(value.size(), width);
+        return *this;
+    }
+
+    OutputBuffer& integer(long long value, size_t width = 0) {
+        char* first = reserve(24);
+        char* last = std::to_chars(first, first + 24, value).ptr;
+        used += last - first;
+        pad(last - first, width);
+        return *this;
+    }
+
+    OutputBuffer& fixed(double value, int precision, size_t width = 0) {
+        char* first = reserve(352);     // widest finite double in fixed notation
+        char* last = std::to_chars(first, first + 352, value, std::chars_format::fixed, precision).ptr;
+        used += last - first;
+        pad(last - first, width);
+        return *this;
+    }
+
+    // Shortest text that reads back as the same double.
+    OutputBuffer& number(double value) {
+        char* first = reserve(32);
+        char* last = std::to_chars(first, first + 32, value).ptr;
+        used += last - first;
+        return *this;
+    }
+
+    // JSON string literal with quotes and escapes.
+    OutputBuffer& quoted(std::string_view value) {
+        put('"');
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                put('\\').put(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                text("\\u00").put(hex[(c >> 4) & 0xF]).put(hex[c & 0xF]);
+            } else {
+                put(c);
+            }
+        }
+        return put('"');
+    }
+
+    // Anything already queued on the stream (e.g. through std::cout) goes out
+    // first, then the whole buffer in one write.
+    void flush() {
+        if (used == 0 || !file) {
+            used = 0;
+            return;
+        }
+        std::fflush(file);
+#ifdef _WIN32
+        std::fwrite(data.data(), 1, used, file);
+#else
+        const char* next = data.data();
+        size_t left = used;
+        while (left > 0) {
+            ssize_t written = ::write(fileno(file), next, left);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            next += written;
+            left -= written;
+        }
+#endif
+        used = 0;
+    }
+};
+
+// One finished route as handed to a RouteSink. Views and pointers are only
+// borrowed for the call; path and segments are null for summary results.
+struct RouteRecord {
+    long long seq = 0;
+    std::string_view from;
+    std::string_view to;
+    bool student = false;
+    int stops = 0;                  // 0 when there is no route
+    double distanceKm = 0;
+    double directKm = 0;
+    double travelMinutes = 0;
+    double fare = 0;
+    double farePerKm = 0;
+    std::string_view weather;
+    std::string_view weatherIcon;
+    std::string_view departure;     // "HH:MM", empty unless a departure time was given
+    std::string_view arrival;
+    const std::vector<std::string>* path = nullptr;
+    const std::vector<SegmentInfo>* segments = nullptr;
+};
+
+// Destination for finished routes: a table for people or one line per route
+// for scripts. Sinks write into an OutputBuffer owned by the caller.
+class RouteSink {
+protected:
+    OutputBuffer& out;
+
+public:
+    explicit RouteSink(OutputBuffer& buffer) : out(buffer) {}
+    virtual ~RouteSink() {}
+    virtual void write(const RouteRecord& route) = 0;
+    void flush() { out.flush(); }
+};
+
+// Tab-separated rows under a header line; "-" marks a missing route.
+class TsvRouteSink : public RouteSink {
+public:
+    explicit TsvRouteSink(OutputBuffer& buffer) : RouteSink(buffer) {
+        out.text("seq\tfrom\tto\tstudent\tstops\tdistance_km\ttime_min\tfare\tdepart\tarrive\n");
+    }
+
+    void write(const RouteRecord& route) override {
+        out.integer(route.seq).put('\t').text(route.from).put('\t').text(route.to).put('\t')
+           .put(route.student ? 'y' : 'n').put('\t');
+        if (route.stops == 0) {
+            out.text("0\t-\t-\t-\t").text(route.departure.empty() ? "-" : route.departure).text("\t-\n");
+            return;
+        }
+        out.integer(route.stops).put('\t').fixed(route.distanceKm, 3).put('\t')
+           .fixed(route.travelMinutes, 3).put('\t').fixed(route.fare, 3).put('\t')
+           .text(route.departure.empty() ? "-" : route.departure).put('\t')
+           .text(route.arrival.empty() ? "-" : route.arrival).put('\n');
+    }
+};
+
+// One JSON object per line; a missing route has null distance, time and fare.
+class JsonLinesRouteSink : public RouteSink {
+public:
+    explicit JsonLinesRouteSink(OutputBuffer& buffer) : RouteSink(buffer) {}
+
+    void write(const RouteRecord& route) override {
+        out.text("{\"seq\":").integer(route.seq).text(",\"from\":").quoted(route.from)
+           .text(",\"to\":").quoted(route.to).text(",\"student\":").text(route.student ? "true" : "false")
+           .text(",\"stops\":").integer(route.stops).text(",\"depart\":");
+        if (route.departure.empty()) out.text("null");
+        else out.quoted(route.departure);
+        if (route.stops == 0) {
+            out.text(",\"arrive\":null,\"distance_km\":null,\"time_min\":null,\"fare\":null}\n");
+            return;
+        }
+        out.text(",\"arrive\":");
+        if (route.arrival.empty()) out.text("null");
+        else out.quoted(route.arrival);
+        out.text(",\"distance_km\":").fixed(route.distanceKm, 3)
+           .text(",\"time_min\":").fixed(route.travelMinutes, 3)
+           .text(",\"fare\":").fixed(route.fare, 3);
+        if (route.path) {
+            out.text(",\"path\":[");
+            for (size_t i = 0; i < route.path->size(); i++) {
+                if (i > 0) out.put(',');
+                out.quoted((*route.path)[i]);
+            }
+            out.put(']');
+        }
+        if (route.segments) {
+            out.text(",\"segments\":[");
+            for (size_t i = 0; i < route.segments->size(); i++) {
+                const SegmentInfo& segment = (*route.segments)[i];
+                if (i > 0) out.put(',');
+                out.text("{\"from\":").quoted(segment.from).text(",\"to\":").quoted(segment.to)
+                   .text(",\"km\":").fixed(segment.distance, 3)
+                   .text(",\"traffic\":").fixed(segment.traffic, 2)
+                   .text(",\"time_min\":").integer(segment.travelTime).put('}');
+            }
+            out.put(']');
+        }
+        out.text("}\n");
+    }
+};
+
+// The planner's route table when segments are given, otherwise one aligned
+// row per route under a header printed with the first row.
+class TableRouteSink : public RouteSink {
+private:
+    bool rowHeaderDone = false;
+
+    void writeReport(const RouteRecord& route) {
+        out.put('\n').repeat('=', 80).put('\n');
+        out.text("                     🚌 DHAKA BUS ROUTE PLANNER\n");
+        out.repeat('=', 80).text("\n\n");
+
+        out.text("💰 Base Rate: ").number(route.farePerKm).text(" per km (Direct)\n");
+        out.text("🌤️  Current Weather: ").text(route.weatherIcon).put(' ').text(route.weather).put('\n');
+
+        out.text("📍 Route: ");
+        if (route.path) {
+            for (size_t i = 0; i < route.path->size(); i++) {
+                if (i > 0) out.text(" → ");
+                out.text((*route.path)[i]);
+            }
+        }
+        out.text("\n\n");
+
+        out.repeat('-', 100).put('\n');
+        out.text("Segment", 20).text("Distance", 12).text("Traffic", 10).text("Time Factor", 12)
+           .text("Weather", 10).text("Time", 10).text("Fare(৳)", 15).text("Status\n");
+        out.repeat('-', 100).put('\n');
+
+        for (const auto& segment : *route.segments) {
+            size_t nameBytes = segment.from.size() + 3 + segment.to.size();    // "→" is 3 bytes
+            out.text(segment.from).text("→").text(segment.to);
+            if (nameBytes < 20) out.repeat(' ', 20 - nameBytes);
+            out.fixed(segment.distance, 2, 12).fixed(segment.traffic, 2, 10)
+               .fixed(segment.timeFactor, 2, 12).fixed(segment.weatherImpact, 2, 10);
+            char time[16];
+            char* timeEnd = std::to_chars(time, time + 12, segment.travelTime).ptr;
+            std::memcpy(timeEnd, "min", 3);
+            out.text(std::string_view(time, timeEnd + 3 - time), 10);
+            out.text("-", 15)      // Segment fare show korbe na
+               .text(segment.trafficColor).put(' ').text(segment.trafficStatus).put('\n');
+        }
+
+        out.repeat('=', 100).put('\n');
+        out.text("📊 JOURNEY SUMMARY:\n");
+        out.repeat('-', 50).put('\n');
+        out.text("Route Distance:  ").fixed(route.distanceKm, 2, 10).text(" km (Actual Path)\n");
+        out.text("Direct Distance: ").fixed(route.directKm, 2, 10).text(" km (For Fare)\n");
+        out.text("Total Fare:      ").text("৳ ", 10).fixed(route.fare, 2);
+        if (route.student) out.text(" (Student Fare Applied)");
+        out.put('\n');
+        out.text("Total Time:      ").integer(static_cast<long long>(route.travelMinutes), 10).text(" minutes\n");
+        out.text("Segments:        ").integer(static_cast<long long>(route.segments->size()), 10).put('\n');
+        out.repeat('-', 50).put('\n');
+        out.text("\nTraffic Legend: 🟢 Smooth  🟡 Light  🟠 Moderate  🔴 Heavy\n");
+        if (!route.departure.empty()) {
+            out.text("🕒 Departure ").text(route.departure).text(" → arrival around ").text(route.arrival).put('\n');
+        }
+    }
+
+public:
+    explicit TableRouteSink(OutputBuffer& buffer) : RouteSink(buffer) {}
+
+    void write(const RouteRecord& route) override {
+        if (route.segments) {
+            writeReport(route);
+            return;
+        }
+        if (!rowHeaderDone) {
+            out.text("Seq", 8).text("From", 20).text("To", 20).text("Stops", 8).text("Distance", 12)
+               .text("Time", 10).text("Fare(৳)", 12).text("Depart", 8).text("Arrive\n");
+            out.repeat('-', 106).put('\n');
+            rowHeaderDone = true;
+        }
+        out.integer(route.seq, 8).text(route.from, 20).text(route.to, 20);
+        if (route.stops == 0) {
+            out.text("-", 8).text("no route\n");
+            return;
+        }
+        out.integer(route.stops, 8).fixed(route.distanceKm, 2, 12).fixed(route.travelMinutes, 1, 10)
+           .fixed(route.fare, 2, 10)
+           .text(route.departure.empty() ? "-" : route.departure, 8)
+           .text(route.arrival.empty() ? "-" : route.arrival).put('\n');
+    }
+};
+
+// A stop an isochrone search reached, with the minutes (or km) it took.
+struct ReachableStop {
+    int id;
+    double cost;
+};
+
+// Bounded LRU cache of routes keyed by (start, end, bucket); the bucket
+// separates routes that depend on something besides the endpoints, such as
+// the departure time. Entries remember the graph generation they were
+// computed for and are dropped lazily once the network has changed.
+class RouteCache {
+private:
+    struct Key {
+        uint64_t ends;
+        int bucket;
+
+        bool operator==(const Key& other) const { return ends == other.ends && bucket == other.bucket; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.ends ^ (static_cast<uint64_t>(key.bucket) * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+
+    struct Entry {
+        Key key;
+        unsigned long long generation;
+        std::vector<int> path;
+    };
+
+    size_t capacity;
+    std::list<Entry> entries;       // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+
+    static Key makeKey(int start, int end, int bucket) {
+        return Key{(static_cast<uint64_t>(static_cast<uint32_t>(start)) << 32) | static_cast<uint32_t>(end), bucket};
+    }
+
+public:
+    long long hits = 0;
+    long long misses = 0;
+    long long evictions = 0;
+    long long staleDrops = 0;
+
+    explicit RouteCache(size_t maxEntries = 1024) : capacity(maxEntries) {}
+
+    size_t size() const { return entries.size(); }
+    size_t getCapacity() const { return capacity; }
+
+    bool lookup(int start, int end, unsigned long long generation, std::vector<int>& path, int bucket = 0) {
+        auto it = index.find(makeKey(start, end, bucket));
+        if (it == index.end()) {
+            misses++;
+            return false;
+        }
+        if (it->second->generation != generation) {
+            entries.erase(it->second);
+            index.erase(it);
+            staleDrops++;
+            misses++;
+            return false;
+        }
+
+        entries.splice(entries.begin(), entries, it->second);
+        path = it->second->path;
+        hits++;
+        return true;
+    }
+
+    void store(int start, int end, unsigned long long generation, const std::vector<int>& path, int bucket = 0) {
+        if (capacity == 0) return;
+        Key key = makeKey(start, end, bucket);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second->generation = generation;
+            it->second->path = path;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+
+        if (entries.size() >= capacity) {
+            index.erase(entries.back().key);
+            entries.pop_back();
+            evictions++;
+        }
+        entries.push_front(Entry{key, generation, path});
+        index[key] = entries.begin();
+    }
+};
+
+// Runs one preprocessing job at a time off the writer thread. Each result is
+// tagged with the graph generation it was built from; one that finishes
+// after the network has changed again is dropped rather than published.
+template <typename T>
+class BackgroundBuild {
+private:
+    struct Result {
+        std::shared_ptr<const T> value;
+        double millis = 0;
+    };
+
+    std::future<Result> pending;
+    unsigned long long generation = 0;
+
+public:
+    // True from start() until the result has been taken.
+    bool running() const { return pending.valid(); }
+
+    void start(unsigned long long forGeneration, std::function<std::shared_ptr<const T>()> job) {
+        generation = forGeneration;
+        pending = std::async(std::launch::async, [job]() {
+            auto started = std::chrono::steady_clock::now();
+            Result result;
+            result.value = job();
+            result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            return result;
+        });
+    }
+
+    // Hands over a finished result built for currentGeneration. Without wait
+    // this never blocks and returns false while the job is still running.
+    bool take(unsigned long long currentGeneration, bool wait, std::shared_ptr<const T>& value, double& millis) {
+        if (!pending.valid()) return false;
+        if (!wait && pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+        Result result = pending.get();
+        if (generation != currentGeneration) return false;
+        value = result.value;
+        millis = result.millis;
+        return true;
+    }
+};
+
+// Everything a route search reads, published as one immutable version.
+// Copies share the network arrays and the preprocessed tables, so building
+// the next version only pays for what actually changed.
+struct RoutingSnapshot {
+    BusNetwork network;
+    std::shared_ptr<const ContractionHierarchy> hierarchy;
+    std::shared_ptr<const LandmarkTable> landmarks;
+    std::shared_ptr<const TrafficModel> traffic;
+    std::string weather;
+    unsigned long long generation = 0;
+};
+
+class DhakaBusSystem {
+private:
+    BusNetwork network;
+    SpatialGrid grid;
+    double linkRadiusKm;
+    bool verifyIncremental = false;
+    SearchMode searchMode = SearchMode::Dijkstra;
+    SearchStats lastSearch;
+    SearchStats totalSearch;
+    std::shared_ptr<const ContractionHierarchy> hierarchy;     // null until first needed
+    std::shared_ptr<const LandmarkTable> landmarkTable;
+    std::shared_ptr<const TrafficModel> trafficModel;
+    std::shared_ptr<const StopKdTree> stopTree;
+    BackgroundBuild<ContractionHierarchy> hierarchyBuild;
+    BackgroundBuild<LandmarkTable> landmarkBuild;
+    const int LANDMARK_COUNT = 8;
+    const std::string LANDMARK_FILE = "landmarks.bin";
+    const std::string LOCATIONS_FILE = "locations.txt";
+    const std::string SNAPSHOT_FILE = "locations.snap";
+    const size_t PLACE_SUGGESTIONS = 8;
+    const int PLACE_LIST_LIMIT = 50;      // larger networks are not listed before prompts
+    bool gridReady = false;
+    int workerThreads = 0;
+    std::unique_ptr<WorkerPool> workerPool;
+    unsigned long long graphGeneration = 0;
+    RouteCache routeCache;
+    RouteCache timedRouteCache;                 // findRouteAt() by departure bucket
+    OutputBuffer consoleBuffer{stdout};         // reused by every route report
+    TableRouteSink consoleTable{consoleBuffer};
+    const int DEPARTURE_BUCKET_MINUTES = 15;
+    HeapKind heapKind = DEFAULT_HEAP;
+
+    SnapshotPublisher<RoutingSnapshot> snapshots;
+
+    // Everything derived from the adjacency is now stale. Searches keep
+    // running on the fallback until the active mode's tables are rebuilt.
+    void networkChanged() {
+        graphGeneration++;
+        hierarchy.reset();
+        landmarkTable.reset();
+        trafficModel.reset();
+        stopTree.reset();
+        publishSnapshot();
+        prepareSearch(searchMode, false);
+    }
+    WeatherSystem weatherSystem;
+    std::string currentWeather;
+    const double BASE_FARE_PER_KM = 2.45;
+
+    // The members above are the writer's working copy; concurrent searches
+    // only ever see the versions handed out here.
+    void publishSnapshot() {
+        std::unique_ptr<RoutingSnapshot> next(new RoutingSnapshot());
+        next->network = network;
+        next->hierarchy = hierarchy;
+        next->landmarks = landmarkTable;
+        next->traffic = trafficModel;
+        next->weather = currentWeather;
+        next->generation = graphGeneration;
+        snapshots.publish(std::move(next));
+    }
+
+public:
+    explicit DhakaBusSystem(double radiusKm = 5.0) : linkRadiusKm(radiusKm) {
+        currentWeather = weatherSystem.getRandomWeather();
+        bool fromSnapshot;
+        {
+            PhaseTimer timer(Metrics::Load);
+            fromSnapshot = loadSnapshot();
+            if (!fromSnapshot) loadLocationsFromFile();
+        }
+        if (!fromSnapshot) {
+            buildGraph();
+            if (network.size() > 0 && !network.saveSnapshot(SNAPSHOT_FILE, linkRadiusKm)) {
+                std::cout << "⚠️ Error: Could not write " << SNAPSHOT_FILE << "!\n";
+            }
+        }
+        publishSnapshot();
+        std::cout << "🚌 Dhaka Bus System Initialized!\n";
+        std::cout << "💰 Fare Rate: " << BASE_FARE_PER_KM << " per km (Direct Distance)\n";
+        std::cout << "🌤️  Current Weather: " << currentWeather << "\n\n";
+    }
+
+    // In-memory network built straight from the given places; nothing is read
+    // from or written to disk. Used for the benchmark's synthetic cities.
+    DhakaBusSystem(const std::vector<PlaceEntry>& places, double radiusKm) : linkRadiusKm(radiusKm) {
+        currentWeather = weatherSystem.getRandomWeather();
+        std::vector<char> chars;
+        std::vector<uint32_t> offsets(1, 0);
+        std::vector<double> lats;
+        std::vector<double> lons;
+        for (const PlaceEntry& place : places) {
+            chars.insert(chars.end(), place.name.begin(), place.name.end());
+            offsets.push_back(static_cast<uint32_t>(chars.size()));
+            lats.push_back(place.lat);
+            lons.push_back(place.lon);
+        }
+        network.setPlaces(std::move(chars), std::move(offsets), std::move(lats), std::move(lons));
+        buildGraph();
+        publishSnapshot();
+    }
+
+    // Uses locations.snap unless locations.txt has been edited since it was written.
+    bool loadSnapshot() {
+        std::error_code error;
+        auto snapshotTime = std::filesystem::last_write_time(SNAPSHOT_FILE, error);
+        if (error) return false;
+        auto textTime = std::filesystem::last_write_time(LOCATIONS_FILE, error);
+        if (!error && textTime > snapshotTime) {
+            std::cout << "🔄 " << LOCATIONS_FILE << " is newer than " << SNAPSHOT_FILE << ", rebuilding...\n";
+            return false;
+        }
+
+        if (!network.loadSnapshot(SNAPSHOT_FILE, linkRadiusKm)) return false;
+        networkChanged();
+        std::cout << "⚡ Snapshot theke " << network.size() << " ti location load kora hoyeche ("
+                  << network.connectedCount() << " connected).\n";
+        return true;
+    }
+
+    // Maps locations.txt and tokenizes it in place, one "name lat lon" row per
+    // line. Bad rows are reported with their line number and skipped; a name
+    // seen twice keeps its last coordinates.
+    void loadLocationsFromFile() {
+        MappedFile file;
+        if (!file.open(LOCATIONS_FILE)) {
+            std::cout << "⚠️ Error: locations.txt file pawa jacche na! Program bondho hoye jabe.\n";
+            return;
+        }
+
+        std::vector<char> chars;
+        std::vector<uint32_t> offsets(1, 0);
+        std::vector<double> lats;
+        std::vector<double> lons;
+        std::unordered_map<std::string_view, int> seen;
+        int count = 0;
+        int malformed = 0;
+        const int maxReported = 10;
+
+        size_t expectedRows = file.size() / 24 + 1;
+        seen.reserve(expectedRows);
+        lats.reserve(expectedRows);
+        lons.reserve(expectedRows);
+        offsets.reserve(expectedRows + 1);
+        chars.reserve(file.size() / 2);
+
+        const char* p = file.data();
+        const char* fileEnd = p + file.size();
+        auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+
+        for (long long lineNumber = 1; p < fileEnd; lineNumber++) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', fileEnd - p));
+            if (!lineEnd) lineEnd = fileEnd;
+
+            const char* fields[3];
+            const char* fieldEnds[3];
+            int fieldCount = 0;
+            const char* c = p;
+            while (c < lineEnd) {
+                while (c < lineEnd && isSpace(*c)) c++;
+                if (c == lineEnd) break;
+                const char* tokenStart = c;
+                while (c < lineEnd && !isSpace(*c)) c++;
+                if (fieldCount < 3) {
+                    fields[fieldCount] = tokenStart;
+                    fieldEnds[fieldCount] = c;
+                }
+                fieldCount++;
+            }
+            p = (lineEnd == fileEnd) ? fileEnd : lineEnd + 1;
+            if (fieldCount == 0) continue;
+
+            auto parseNumber = [](const char* first, const char* last, double& value) {
+                if (first < last && *first == '+') first++;
+                auto result = std::from_chars(first, last, value);
+                return result.ec == std::errc() && result.ptr == last;
+            };
+
+            const char* problem = nullptr;
+            double lat = 0, lon = 0;
+            if (fieldCount != 3) {
+                problem = "expected 'name latitude longitude'";
+            } else if (!parseNumber(fields[1], fieldEnds[1], lat) || lat < -90 || lat > 90) {
+                problem = "invalid latitude";
+            } else if (!parseNumber(fields[2], fieldEnds[2], lon) || lon < -180 || lon > 180) {
+                problem = "invalid longitude";
+            }
+            if (problem) {
+                if (malformed < maxReported) {
+                    std::cout << "⚠️ " << LOCATIONS_FILE << " line " << lineNumber << ": " << problem << "\n";
+                }
+                malformed++;
+                continue;
+            }
+
+            std::string_view name(fields[0], fieldEnds[0] - fields[0]);
+            auto it = seen.find(name);
+            if (it != seen.end()) {
+                lats[it->second] = lat;
+                lons[it->second] = lon;
+            } else {
+                seen.emplace(name, static_cast<int>(lats.size()));
+                chars.insert(chars.end(), name.begin(), name.end());
+                offsets.push_back(static_cast<uint32_t>(chars.size()));
+                lats.push_back(lat);
+                lons.push_back(lon);
+            }
+            count++;
+        }
+
+        network.setPlaces(std::move(chars), std::move(offsets), std::move(lats), std::move(lons));
+        std::cout << "📂 File theke " << count << " ti location load kora hoyeche.\n";
+        if (malformed > 0) {
+            std::cout << "⚠️ " << malformed << " ti line skip kora hoyeche (malformed).\n";
+        }
+    }
+
+    double calculateDistance(double lat1, double lon1, double lat2, double lon2) {
+        const double R = 6371.0;
+        double dLat = (lat2 - lat1) * 3.14159 / 180.0;
+        double dLon = (lon2 - lon1) * 3.14159 / 180.0;
+
+        double a = sin(dLat/2) * sin(dLat/2) +
+                   cos(lat1 * 3.14159/180.0) * cos(lat2 * 3.14159/180.0) * sin(dLon/2) * sin(dLon/2);
+        double c = 2 * atan2(sqrt(a), sqrt(1-a));
+        return R * c;
+    }
+
+    void rebuildGrid() {
+        int n = network.size();
+        double maxAbsLat = 0.0;
+        for (int id = 0; id < n; id++) {
+            maxAbsLat = std::max(maxAbsLat, std::fabs(network.latitudes[id]));
+        }
+        grid.reset(linkRadiusKm, maxAbsLat);
+        for (int id = 0; id < n; id++) {
+            grid.insert(id, network.latitudes[id], network.longitudes[id]);
+        }
+        gridReady = true;
+    }
+
+    void buildGraph() {
+        PhaseTimer timer(Metrics::Build);
+        std::cout << "🔄 Building route network...";
+        rebuildGrid();
+
+        // Only places in neighbouring cells can be within the radius. Each cell
+        // gathers its 3x3 neighbourhood into contiguous columns once and runs
+        // the batch kernel for every member; each pair is linked both ways.
+        std::vector<RouteEdge> edges;
+        double limit = GeoKernel::radiusToChordSquared(linkRadiusKm);
+        std::vector<int> blockIds;
+        std::vector<double> bx, by, bz;
+        std::vector<int> hits;
+        std::vector<double> hitChords;
+        grid.forEachCell([&](long long row, long long col, const std::vector<int>& members) {
+            blockIds.clear();
+            bx.clear();
+            by.clear();
+            bz.clear();
+            grid.forEachNeighbourCell(row, col, [&](const std::vector<int>& ids) {
+                for (int id : ids) {
+                    blockIds.push_back(id);
+                    bx.push_back(network.unitX[id]);
+                    by.push_back(network.unitY[id]);
+                    bz.push_back(network.unitZ[id]);
+                }
+            });
+            hits.resize(blockIds.size());
+            hitChords.resize(blockIds.size());
+
+            for (int a : members) {
+                int found = GeoKernel::within(network.unitX[a], network.unitY[a], network.unitZ[a],
+                                              bx.data(), by.data(), bz.data(), static_cast<int>(blockIds.size()),
+                                              limit, hits.data(), hitChords.data());
+                for (int k = 0; k < found; k++) {
+                    int b = blockIds[hits[k]];
+                    if (b <= a) continue;
+                    double dist = GeoKernel::chordToKm(hitChords[k]);
+                    edges.push_back(RouteEdge{a, b, dist});
+                    edges.push_back(RouteEdge{b, a, dist});
+                }
+            }
+        });
+        network.setEdges(edges);
+        networkChanged();
+        std::cout << " ✅ Done! (" << network.connectedCount() << " locations connected)\n";
+    }
+
+    // Inserts a batch of new places, linking only their neighbours within the
+    // radius and merging the new edges into the network once for the batch.
+    // Names that already exist are skipped; returns how many were added.
+    int addPlaces(const std::vector<PlaceEntry>& batch) {
+        if (!gridReady) rebuildGrid();
+        int firstNew = network.size();
+        bool gridStale = false;
+        for (auto& entry : batch) {
+            if (placeExists(entry.name)) continue;
+            int id = network.addPlace(entry.name, entry.lat, entry.lon);
+            if (!grid.covers(entry.lat)) gridStale = true;
+            grid.insert(id, entry.lat, entry.lon);
+        }
+
+        int added = network.size() - firstNew;
+        if (added == 0) return 0;
+
+        if (gridStale) {
+            // Cell width was sized for lower latitudes; resize the grid.
+            buildGraph();
+            return added;
+        }
+
+        PhaseTimer timer(Metrics::Build);
+        std::vector<RouteEdge> edges;
+        double limit = GeoKernel::radiusToChordSquared(linkRadiusKm);
+        for (int a = firstNew; a < network.size(); a++) {
+            grid.forEachCandidate(network.latitudes[a], network.longitudes[a], [&](int b) {
+                if (b == a || (b >= firstNew && b > a)) return;
+                double chordSquared = network.chordSquared(a, b);
+                if (chordSquared < limit) {
+                    double dist = GeoKernel::chordToKm(chordSquared);
+                    edges.push_back(RouteEdge{a, b, dist});
+                    edges.push_back(RouteEdge{b, a, dist});
+                }
+            });
+        }
+        network.addEdges(edges);
+        networkChanged();
+
+        if (verifyIncremental) {
+            verifyGraph();
+        }
+        return added;
+    }
+
+    // Rebuilds the full network and checks it against the current adjacency.
+    bool verifyGraph() {
+        auto sortedRows = [this]() {
+            std::vector<std::vector<std::pair<int, double>>> rows(network.size());
+            for (int u = 0; u < network.size(); u++) {
+                for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                    rows[u].push_back(std::make_pair(network.edgeTargets[e], network.edgeWeights[e]));
+                }
+                std::sort(rows[u].begin(), rows[u].end());
+            }
+            return rows;
+        };
+
+        auto incremental = sortedRows();
+        buildGraph();
+        bool match = (incremental == sortedRows());
+        if (match) {
+            std::cout << "🔍 Graph verification passed (incremental == full rebuild)\n";
+        } else {
+            std::cout << "⚠️ Graph verification FAILED: incremental update differs from full rebuild!\n";
+        }
+        return match;
+    }
+
+    void setVerifyIncremental(bool enabled) {
+        verifyIncremental = enabled;
+    }
+
+    double getLinkRadius() const {
+        return linkRadiusKm;
+    }
+
+    void setLinkRadius(double radiusKm) {
+        linkRadiusKm = radiusKm;
+        buildGraph();
+    }
+
+    std::vector<std::string> findShortestPath(const std::string& start, const std::string& end) {
+        return findShortestPath(start, end, searchMode);
+    }
+
+    std::vector<std::string> findShortestPath(const std::string& start, const std::string& end,
+                                              SearchMode mode) {
+        int startId = network.findId(start);
+        int endId = network.findId(end);
+        if (startId < 0 || endId < 0) {
+            return std::vector<std::string>();
+        }
+
+        std::vector<int> ids;
+        if (routeCache.lookup(startId, endId, graphGeneration, ids)) {
+            Metrics::add(Metrics::CacheHits, 1);
+        } else {
+            Metrics::add(Metrics::CacheMisses, 1);
+            findShortestPath(startId, endId, mode, ids);
+            routeCache.store(startId, endId, graphGeneration, ids);
+        }
+
+        std::vector<std::string> path;
+        for (int id : ids) {
+            path.emplace_back(network.name(id));
+        }
+        return path;
+    }
+
+    // Dijkstra, or A* guided by the straight-line distance to the target (edge
+    // weights are great-circle distances, so it is consistent) or by the
+    // landmark triangle-inequality bound (ALT).
+    std::vector<int> findShortestPath(int start, int end, SearchMode mode = SearchMode::Dijkstra) {
+        std::vector<int> path;
+        findShortestPath(start, end, mode, path);
+        return path;
+    }
+
+    // Same, writing the route into the caller's buffer (empty if unreachable).
+    // Searches run in this thread's SearchWorkspace, so nothing is allocated
+    // once the workspace and the buffer have grown to size.
+    void findShortestPath(int start, int end, SearchMode mode, std::vector<int>& path) {
+        prepareSearch(mode, false);
+        SearchStats stats;
+        auto snapshot = snapshots.pin();
+        searchRoute(*snapshot, start, end, mode, path, stats);
+        lastSearch = stats;
+        totalSearch.add(stats);
+    }
+
+    // Builds and publishes whatever the mode needs up front, so searchRoute()
+    // can then be called from several threads at once. Without wait the
+    // tables are built in the background and published once ready; until
+    // then searchRoute() falls back to Dijkstra.
+    void prepareSearch(SearchMode mode, bool wait = true) {
+        if (mode == SearchMode::ContractionHierarchy) ensureHierarchy(wait);
+        if (mode == SearchMode::Landmarks) ensureLandmarks(wait);
+    }
+
+    // Read-only search over a pinned snapshot; counters are added to stats
+    // instead of lastSearch. A mode whose table is missing from the snapshot
+    // falls back to plain Dijkstra.
+    void searchRoute(const RoutingSnapshot& snapshot, int start, int end, SearchMode mode,
+                     std::vector<int>& path, SearchStats& stats) const {
+        SearchStats before = stats;
+        {
+            PhaseTimer timer(Metrics::Query);
+            dispatchSearch(snapshot, start, end, mode, path, stats);
+        }
+        recordSearch(before, stats);
+    }
+
+    // Settled nodes and relaxed edges one search added to stats.
+    static void recordSearch(const SearchStats& before, const SearchStats& after) {
+        Metrics::add(Metrics::SettledNodes, after.settledNodes - before.settledNodes);
+        Metrics::add(Metrics::RelaxedEdges, after.relaxedEdges - before.relaxedEdges);
+    }
+
+    void dispatchSearch(const RoutingSnapshot& snapshot, int start, int end, SearchMode mode,
+                        std::vector<int>& path, SearchStats& stats) const {
+        SearchWorkspace& workspace = SearchWorkspace::local();
+        stats.queries++;
+        if (mode == SearchMode::ContractionHierarchy && !snapshot.hierarchy) {
+            mode = SearchMode::Dijkstra;
+        }
+        if (mode == SearchMode::Landmarks && (!snapshot.landmarks || !snapshot.landmarks->isReady())) {
+            mode = SearchMode::Dijkstra;
+        }
+
+        workspace.withHeaps(heapKind, [&](auto& heaps) {
+            if (mode == SearchMode::Bidirectional) {
+                findShortestPathBidirectional(snapshot.network, start, end, workspace, heaps, path, stats);
+            } else if (mode == SearchMode::ContractionHierarchy) {
+                snapshot.hierarchy->query(start, end, workspace, heaps, path, stats);
+            } else {
+                searchWithHeap(snapshot, heaps[0], workspace.labels[0], start, end, mode, path, stats);
+            }
+        });
+    }
+
+    template <typename Heap>
+    void searchWithHeap(const RoutingSnapshot& snapshot, Heap& heap, SearchLabels& labels, int start, int end,
+                        SearchMode mode, std::vector<int>& path, SearchStats& stats) const {
+        const BusNetwork& network = snapshot.network;
+        labels.reset(network.size());
+
+        auto heuristic = [&](int v) {
+            if (mode == SearchMode::Dijkstra) return 0.0;
+            double& estimate = labels.estimate(v);
+            if (estimate < 0) {
+                if (mode == SearchMode::Landmarks) {
+                    estimate = snapshot.landmarks->lowerBound(v, end) * (1.0 - 1e-9);
+                } else {
+                    estimate = network.chordLowerBound(v, end) * (1.0 - 1e-9);
+                }
+            }
+            return estimate;
+        };
+
+        labels.update(start, 0, -1);
+        heap.clear();
+        heap.push(heuristic(start), start);
+        stats.heapPushes++;
+
+        while (!heap.empty()) {
+            double key;
+            int u;
+            heap.pop(key, u);
+            stats.heapPops++;
+
+            if (labels.settled(u)) {
+                stats.stalePops++;
+                continue;
+            }
+            labels.settle(u);
+            stats.settledNodes++;
+            if (u == end) break;
+
+            double du = labels.distance(u);
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                int v = network.edgeTargets[e];
+                double weight = network.edgeWeights[e];
+                stats.relaxedEdges++;
+
+                if (du + weight < labels.distance(v)) {
+                    labels.update(v, du + weight, u);
+                    heap.push(du + weight + heuristic(v), v);
+                    stats.heapPushes++;
+                }
+            }
+        }
+        heap.clear();
+
+        path.clear();
+        if (labels.reached(end)) {
+            labels.tracePath(end, path);
+        }
+    }
+
+    void setHeapKind(HeapKind kind) {
+        heapKind = kind;
+    }
+
+    // Grows forward and backward Dijkstra frontiers alternately. The graph is
+    // symmetric, so the backward search walks the same CSR rows. Stops once the
+    // two queue minima together can no longer beat the best meeting point.
+    template <typename Heap>
+    void findShortestPathBidirectional(const BusNetwork& network, int start, int end, SearchWorkspace& workspace,
+                                       Heap* heap, std::vector<int>& path, SearchStats& stats) const {
+        SearchLabels* labels = workspace.labels;
+
+        for (int side = 0; side < 2; side++) {
+            labels[side].reset(network.size());
+            heap[side].clear();
+        }
+        labels[0].update(start, 0, -1);
+        labels[1].update(end, 0, -1);
+        heap[0].push(0.0, start);
+        heap[1].push(0.0, end);
+
+        double best = (start == end) ? 0.0 : 1e18;
+        int meet = (start == end) ? start : -1;
+        int side = 0;
+
+        while (!heap[0].empty() && !heap[1].empty()) {
+            if (heap[0].topKey() + heap[1].topKey() >= best) break;
+
+            double key;
+            int u;
+            heap[side].pop(key, u);
+            if (!labels[side].settled(u)) {
+                labels[side].settle(u);
+                stats.settledNodes++;
+
+                double du = labels[side].distance(u);
+                for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                    int v = network.edgeTargets[e];
+                    double weight = network.edgeWeights[e];
+                    stats.relaxedEdges++;
+
+                    if (du + weight < labels[side].distance(v)) {
+                        labels[side].update(v, du + weight, u);
+                        heap[side].push(du + weight, v);
+                    }
+                    double through = labels[side].distance(v) + labels[1 - side].distance(v);
+                    if (through < best) {
+                        best = through;
+                        meet = v;
+                    }
+                }
+            }
+            side = 1 - side;
+        }
+
+        path.clear();
+        if (meet < 0) {
+            return;
+        }
+
+        labels[0].tracePath(meet, path);
+        for (int current = labels[1].parent(meet); current != -1; current = labels[1].parent(current)) {
+            path.push_back(current);
+        }
+    }
+
+    // Earliest-arrival route when leaving start at departMinute (minutes after
+    // midnight, may run past 1440). Returns the arrival minute, or -1 with an
+    // empty path when end cannot be reached.
+    double findRouteAt(int start, int end, double departMinute, std::vector<int>& path) {
+        ensureTrafficModel();
+        SearchStats stats;
+        auto snapshot = snapshots.pin();
+        double arrival = searchTimeDependent(*snapshot, start, end, departMinute, path, stats);
+        lastSearch = stats;
+        totalSearch.add(stats);
+        return arrival;
+    }
+
+    // Same, by name. Routes are cached per DEPARTURE_BUCKET_MINUTES of the
+    // day, apart from the distance-only routes in routeCache.
+    std::vector<std::string> findRouteAt(const std::string& start, const std::string& end, double departMinute) {
+        std::vector<std::string> path;
+        int startId = network.findId(start);
+        int endId = network.findId(end);
+        if (startId < 0 || endId < 0) {
+            return path;
+        }
+
+        std::vector<int> ids;
+        int bucket = static_cast<int>(std::fmod(departMinute, 1440.0)) / DEPARTURE_BUCKET_MINUTES;
+        if (timedRouteCache.lookup(startId, endId, graphGeneration, ids, bucket)) {
+            Metrics::add(Metrics::CacheHits, 1);
+        } else {
+            Metrics::add(Metrics::CacheMisses, 1);
+            findRouteAt(startId, endId, departMinute, ids);
+            timedRouteCache.store(startId, endId, graphGeneration, ids, bucket);
+        }
+        for (int id : ids) {
+            path.emplace_back(network.name(id));
+        }
+        return path;
+    }
+
+    // Up to k loopless routes from start to end, shortest first (Yen's
+    // algorithm). Each route's length in km goes into lengths.
+    void findAlternativeRoutes(int start, int end, int k, std::vector<std::vector<int>>& routes,
+                               std::vector<double>& lengths) {
+        SearchStats stats;
+        auto snapshot = snapshots.pin();
+        SearchStats before = stats;
+        {
+            PhaseTimer timer(Metrics::Query);
+            searchAlternatives(*snapshot, start, end, k, routes, lengths, stats);
+        }
+        recordSearch(before, stats);
+        lastSearch = stats;
+        totalSearch.add(stats);
+    }
+
+    std::vector<std::vector<std::string>> findAlternativeRoutes(const std::string& start, const std::string& end,
+                                                                int k) {
+        std::vector<std::vector<std::string>> named;
+        int startId = network.findId(start);
+        int endId = network.findId(end);
+        if (startId < 0 || endId < 0) {
+            return named;
+        }
+
+        std::vector<std::vector<int>> routes;
+        std::vector<double> lengths;
+        findAlternativeRoutes(startId, endId, k, routes, lengths);
+        for (const auto& route : routes) {
+            named.emplace_back();
+            for (int id : route) named.back().emplace_back(network.name(id));
+        }
+        return named;
+    }
+
+    // One backward Dijkstra from end (labels[1]) gives the first route and
+    // exact distances to end within a ball of 1.25x its length; outside it
+    // the ball radius and the chord bound still bound the rest. Spur searches
+    // are A* on that bound, skip places on the root path (workspace.excluded)
+    // and stop as soon as they cannot beat the k-th best candidate so far.
+    void searchAlternatives(const RoutingSnapshot& snapshot, int start, int end, int k,
+                            std::vector<std::vector<int>>& routes, std::vector<double>& lengths,
+                            SearchStats& stats) const {
+        SearchWorkspace& workspace = SearchWorkspace::local();
+        workspace.withHeaps(heapKind, [&](auto& heaps) {
+            alternativesWithHeap(snapshot, workspace, heaps, start, end, k, routes, lengths, stats);
+        });
+    }
+
+    template <typename Heap>
+    void alternativesWithHeap(const RoutingSnapshot& snapshot, SearchWorkspace& workspace, Heap* heaps, int start,
+                              int end, int k, std::vector<std::vector<int>>& routes, std::vector<double>& lengths,
+                              SearchStats& stats) const {
+        const BusNetwork& network = snapshot.network;
+        SearchLabels& toEnd = workspace.labels[1];
+        routes.clear();
+        lengths.clear();
+        if (k <= 0) return;
+        stats.queries++;
+
+        // Backward tree; the graph is symmetric so the same rows serve.
+        Heap& backHeap = heaps[1];
+        toEnd.reset(network.size());
+        backHeap.clear();
+        toEnd.update(end, 0, -1);
+        backHeap.push(0, end);
+        stats.heapPushes++;
+        double radius = 1e18;
+        double settledRadius = 0;
+        while (!backHeap.empty()) {
+            double key;
+            int u;
+            backHeap.pop(key, u);
+            stats.heapPops++;
+            if (toEnd.settled(u)) {
+                stats.stalePops++;
+                continue;
+            }
+            if (key > radius) {
+                settledRadius = key;        // nothing left is closer than this
+                break;
+            }
+            toEnd.settle(u);
+            stats.settledNodes++;
+            settledRadius = key;
+            if (u == start) radius = key * 1.25;
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                int v = network.edgeTargets[e];
+                double dist = key + network.edgeWeights[e];
+                stats.relaxedEdges++;
+                if (dist < toEnd.distance(v)) {
+                    toEnd.update(v, dist, u);
+                    backHeap.push(dist, v);
+                    stats.heapPushes++;
+                }
+            }
+        }
+        backHeap.clear();
+        if (!toEnd.settled(start)) return;
+
+        // Consistent: exact inside the ball, and every place outside it is at
+        // least settledRadius (and its chord) away from end.
+        auto lowerBound = [&](int v) {
+            if (toEnd.settled(v)) return toEnd.distance(v);
+            return std::max(settledRadius, network.chordLowerBound(v, end) * (1.0 - 1e-9));
+        };
+
+        routes.emplace_back();
+        for (int v = start; v != -1; v = toEnd.parent(v)) routes.back().push_back(v);
+        lengths.push_back(toEnd.distance(start));
+
+        struct Candidate {
+            double length;
+            std::vector<int> path;
+        };
+        std::vector<Candidate> candidates;      // kept sorted by length
+        std::vector<double> rootLength;
+        std::vector<int> blockedNext;
+        std::vector<int> spurPath;
+
+        auto edgeWeight = [&](int a, int b) {
+            for (int e = network.edgeOffsets[a]; e < network.edgeOffsets[a + 1]; e++) {
+                if (network.edgeTargets[e] == b) return network.edgeWeights[e];
+            }
+            return 1e18;
+        };
+        auto known = [&](const std::vector<int>& path) {
+            for (const auto& route : routes) if (route == path) return true;
+            for (const auto& candidate : candidates) if (candidate.path == path) return true;
+            return false;
+        };
+
+        while (static_cast<int>(routes.size()) < k) {
+            const std::vector<int> previous = routes.back();
+            rootLength.assign(1, 0.0);
+            for (size_t i = 1; i < previous.size(); i++) {
+                rootLength.push_back(rootLength.back() + edgeWeight(previous[i - 1], previous[i]));
+            }
+
+            for (size_t i = 0; i + 1 < previous.size(); i++) {
+                int spur = previous[i];
+
+                // Only the best (k - found) candidates can still be chosen.
+                size_t needed = k - routes.size();
+                double limit = candidates.size() >= needed ? candidates[needed - 1].length : 1e18;
+                if (rootLength[i] + lowerBound(spur) >= limit) continue;
+
+                blockedNext.clear();
+                for (const auto& route : routes) {
+                    if (route.size() > i + 1 && std::equal(previous.begin(), previous.begin() + i + 1, route.begin())) {
+                        blockedNext.push_back(route[i + 1]);
+                    }
+                }
+                workspace.excluded.reset(network.size());
+                for (size_t j = 0; j < i; j++) workspace.excluded.settle(previous[j]);
+
+                double spurLength = spurSearch(network, workspace, heaps[0], spur, end, blockedNext, lowerBound,
+                                               limit - rootLength[i], spurPath, stats);
+                if (spurPath.empty()) continue;
+
+                Candidate candidate;
+                candidate.length = rootLength[i] + spurLength;
+                candidate.path.assign(previous.begin(), previous.begin() + i);
+                candidate.path.insert(candidate.path.end(), spurPath.begin(), spurPath.end());
+                if (known(candidate.path)) continue;
+                auto at = std::upper_bound(candidates.begin(), candidates.end(), candidate.length,
+                                           [](double length, const Candidate& c) { return length < c.length; });
+                candidates.insert(at, std::move(candidate));
+                if (candidates.size() > needed) candidates.resize(needed);
+            }
+
+            if (candidates.empty()) break;
+            routes.push_back(std::move(candidates.front().path));
+            lengths.push_back(candidates.front().length);
+            candidates.erase(candidates.begin());
+        }
+    }
+
+    // A* from spur to end that never enters an excluded place or takes the
+    // first hop to a blocked neighbour. Gives up (empty path) once no route
+    // shorter than limit is left; returns the route's length.
+    template <typename Heap, typename Bound>
+    double spurSearch(const BusNetwork& network, SearchWorkspace& workspace, Heap& heap, int spur, int end,
+                      const std::vector<int>& blockedNext, const Bound& lowerBound, double limit,
+                      std::vector<int>& path, SearchStats& stats) const {
+        SearchLabels& labels = workspace.labels[0];
+        labels.reset(network.size());
+        heap.clear();
+        labels.update(spur, 0, -1);
+        heap.push(lowerBound(spur), spur);
+        stats.heapPushes++;
+        path.clear();
+
+        while (!heap.empty()) {
+            double key;
+            int u;
+            heap.pop(key, u);
+            stats.heapPops++;
+            if (key >= limit) break;
+            if (labels.settled(u)) {
+                stats.stalePops++;
+                continue;
+            }
+            labels.settle(u);
+            stats.settledNodes++;
+            if (u == end) {
+                labels.tracePath(end, path);
+                break;
+            }
+
+            double du = labels.distance(u);
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                int v = network.edgeTargets[e];
+                stats.relaxedEdges++;
+                if (workspace.excluded.settled(v)) continue;
+                if (u == spur && std::find(blockedNext.begin(), blockedNext.end(), v) != blockedNext.end()) continue;
+                double dist = du + network.edgeWeights[e];
+                if (dist < labels.distance(v)) {
+                    labels.update(v, dist, u);
+                    heap.push(dist + lowerBound(v), v);
+                    stats.heapPushes++;
+                }
+            }
+        }
+        heap.clear();
+        return path.empty() ? 1e18 : labels.distance(end);
+    }
+
+    // Dijkstra on arrival times: an edge costs its profile's travel time at
+    // the moment the bus enters it. All profiles are FIFO, so the first time a
+    // place is settled is also the earliest it can be reached.
+    double searchTimeDependent(const RoutingSnapshot& snapshot, int start, int end, double departMinute,
+                               std::vector<int>& path, SearchStats& stats) const {
+        SearchStats before = stats;
+        double arrival;
+        {
+            PhaseTimer timer(Metrics::Query);
+            arrival = dispatchTimeDependent(snapshot, start, end, departMinute, path, stats);
+        }
+        recordSearch(before, stats);
+        return arrival;
+    }
+
+    double dispatchTimeDependent(const RoutingSnapshot& snapshot, int start, int end, double departMinute,
+                                 std::vector<int>& path, SearchStats& stats) const {
+        SearchWorkspace& workspace = SearchWorkspace::local();
+        double arrival = -1;
+        workspace.withHeaps(heapKind, [&](auto& heaps) {
+            arrival = timeDependentWithHeap(snapshot, heaps[0], workspace.labels[0], start, end, departMinute, path,
+                                            stats);
+        });
+        return arrival;
+    }
+
+    template <typename Heap>
+    double timeDependentWithHeap(const RoutingSnapshot& snapshot, Heap& heap, SearchLabels& labels, int start,
+                                 int end, double departMinute, std::vector<int>& path, SearchStats& stats) const {
+        const BusNetwork& network = snapshot.network;
+        const TrafficModel& traffic = *snapshot.traffic;
+        stats.queries++;
+
+        labels.reset(network.size());
+        heap.clear();
+        labels.update(start, departMinute, -1);
+        heap.push(departMinute, start);
+        stats.heapPushes++;
+
+        while (!heap.empty()) {
+            double now;
+            int u;
+            heap.pop(now, u);
+            stats.heapPops++;
+            if (labels.settled(u)) {
+                stats.stalePops++;
+                continue;
+            }
+            labels.settle(u);
+            stats.settledNodes++;
+            if (u == end) break;
+
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                int v = network.edgeTargets[e];
+                double arrival = now + traffic.travelMinutes(network, e, now);
+                stats.relaxedEdges++;
+                if (arrival < labels.distance(v)) {
+                    labels.update(v, arrival, u, e);
+                    heap.push(arrival, v);
+                    stats.heapPushes++;
+                }
+            }
+        }
+        heap.clear();
+
+        path.clear();
+        if (!labels.reached(end)) {
+            return -1;
+        }
+        labels.tracePath(end, path);
+        return labels.distance(end);
+    }
+
+    // Every stop within budget of start, nearest first: minutes when leaving
+    // at departMinute (the calculateFare time model on each edge's traffic
+    // profile), or km of route when departMinute is negative.
+    void findReachable(int start, double budget, double departMinute, std::vector<ReachableStop>& reached) {
+        if (departMinute >= 0) ensureTrafficModel();
+        SearchStats stats;
+        auto snapshot = snapshots.pin();
+        SearchStats before = stats;
+        {
+            PhaseTimer timer(Metrics::Query);
+            searchReachable(*snapshot, start, budget, departMinute, reached, stats);
+        }
+        recordSearch(before, stats);
+        lastSearch = stats;
+        totalSearch.add(stats);
+    }
+
+    // Dijkstra that stops at the first label over budget, so it only ever
+    // touches the reachable stops and their immediate neighbours.
+    void searchReachable(const RoutingSnapshot& snapshot, int start, double budget, double departMinute,
+                         std::vector<ReachableStop>& reached, SearchStats& stats) const {
+        SearchWorkspace& workspace = SearchWorkspace::local();
+        workspace.withHeaps(heapKind, [&](auto& heaps) {
+            reachableWithHeap(snapshot, heaps[0], workspace.labels[0], start, budget, departMinute, reached, stats);
+        });
+    }
+
+    template <typename Heap>
+    void reachableWithHeap(const RoutingSnapshot& snapshot, Heap& heap, SearchLabels& labels, int start,
+                           double budget, double departMinute, std::vector<ReachableStop>& reached,
+                           SearchStats& stats) const {
+        const BusNetwork& network = snapshot.network;
+        const TrafficModel* traffic = departMinute >= 0 ? snapshot.traffic.get() : nullptr;
+        double origin = traffic ? departMinute : 0.0;
+        stats.queries++;
+        reached.clear();
+
+        labels.reset(network.size());
+        heap.clear();
+        labels.update(start, origin, -1);
+        heap.push(origin, start);
+        stats.heapPushes++;
+
+        while (!heap.empty()) {
+            double key;
+            int u;
+            heap.pop(key, u);
+            stats.heapPops++;
+            if (key - origin > budget) break;
+            if (labels.settled(u)) {
+                stats.stalePops++;
+                continue;
+            }
+            labels.settle(u);
+            stats.settledNodes++;
+            reached.push_back(ReachableStop{u, key - origin});
+
+            for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                int v = network.edgeTargets[e];
+                double next = key + (traffic ? traffic->travelMinutes(network, e, key) : network.edgeWeights[e]);
+                stats.relaxedEdges++;
+                if (next - origin <= budget && next < labels.distance(v)) {
+                    labels.update(v, next, u, e);
+                    heap.push(next, v);
+                    stats.heapPushes++;
+                }
+            }
+        }
+        heap.clear();
+    }
+
+    // Convex hull of the reached stops (Andrew's monotone chain on an
+    // equirectangular projection), counter-clockwise from the south-west.
+    // Fewer than three distinct stops come back as they are.
+    void reachableOutline(const std::vector<ReachableStop>& reached, std::vector<int>& hull) const {
+        std::vector<int> ids;
+        for (const auto& stop : reached) ids.push_back(stop.id);
+        double midLat = 0;
+        for (int id : ids) midLat += network.latitudes[id];
+        double lonScale = ids.empty() ? 1.0 : std::cos(midLat / ids.size() * DEG_TO_RAD);
+        auto x = [&](int id) { return network.longitudes[id] * lonScale; };
+        auto y = [&](int id) { return network.latitudes[id]; };
+        std::sort(ids.begin(), ids.end(), [&](int a, int b) { return x(a) < x(b) || (x(a) == x(b) && y(a) < y(b)); });
+        ids.erase(std::unique(ids.begin(), ids.end(), [&](int a, int b) { return x(a) == x(b) && y(a) == y(b); }),
+                  ids.end());
+
+        hull.clear();
+        if (ids.size() < 3) {
+            hull = ids;
+            return;
+        }
+        auto cross = [&](int o, int a, int b) {
+            return (x(a) - x(o)) * (y(b) - y(o)) - (y(a) - y(o)) * (x(b) - x(o));
+        };
+        hull.resize(2 * ids.size());
+        size_t k = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            while (k >= 2 && cross(hull[k - 2], hull[k - 1], ids[i]) <= 0) k--;
+            hull[k++] = ids[i];
+        }
+        for (size_t i = ids.size() - 1, lower = k + 1; i > 0; i--) {
+            while (k >= lower && cross(hull[k - 2], hull[k - 1], ids[i - 1]) <= 0) k--;
+            hull[k++] = ids[i - 1];
+        }
+        hull.resize(k - 1);      // the last point repeats the first
+    }
+
+    // Area inside the outline in square km (shoelace on a local projection).
+    double outlineAreaKm2(const std::vector<int>& hull) const {
+        if (hull.size() < 3) return 0.0;
+        double kmPerDegree = EARTH_RADIUS_KM * DEG_TO_RAD;
+        double lonScale = std::cos(network.latitudes[hull[0]] * DEG_TO_RAD);
+        double twiceArea = 0;
+        for (size_t i = 0; i < hull.size(); i++) {
+            int a = hull[i];
+            int b = hull[(i + 1) % hull.size()];
+            twiceArea += network.longitudes[a] * lonScale * network.latitudes[b] -
+                         network.longitudes[b] * lonScale * network.latitudes[a];
+        }
+        return std::fabs(twiceArea) / 2 * kmPerDegree * kmPerDegree;
+    }
+
+    // Plain one-to-all Dijkstra; unreachable places stay at 1e18. Static, as
+    // the landmark build runs it off the main thread, so the heap kind is
+    // passed in and the heap comes from that thread's workspace.
+    static void computeDistancesFrom(const BusNetwork& network, int source, std::vector<double>& dist,
+                                     HeapKind kind) {
+        dist.assign(network.size(), 1e18);
+        dist[source] = 0;
+
+        SearchWorkspace::local().withHeaps(kind, [&](auto& heaps) {
+            auto& heap = heaps[0];
+            heap.clear();
+            heap.push(0.0, source);
+            while (!heap.empty()) {
+                double d;
+                int u;
+                heap.pop(d, u);
+                if (d > dist[u]) continue;
+
+                for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                    int v = network.edgeTargets[e];
+                    if (d + network.edgeWeights[e] < dist[v]) {
+                        dist[v] = d + network.edgeWeights[e];
+                        heap.push(dist[v], v);
+                    }
+                }
+            }
+        });
+    }
+
+    // One search per source (stopping once every target is settled), spread
+    // over the worker pool. Travel time uses calculateFare's model at the
+    // current hour's base traffic: distance / 20 km/h * traffic.
+    DistanceMatrix computeMatrix(const std::vector<int>& sources, const std::vector<int>& targets) {
+        DistanceMatrix matrix;
+        matrix.rows = static_cast<int>(sources.size());
+        matrix.cols = static_cast<int>(targets.size());
+        matrix.distanceKm.assign(static_cast<size_t>(matrix.rows) * matrix.cols, 1e18);
+        matrix.travelMinutes.assign(matrix.distanceKm.size(), 1e18);
+
+        auto snapshot = snapshots.pin();
+        const BusNetwork& network = snapshot->network;
+        int n = network.size();
+        std::vector<char> isTarget(n, 0);
+        int distinctTargets = 0;
+        for (int t : targets) {
+            if (!isTarget[t]) distinctTargets++;
+            isTarget[t] = 1;
+        }
+
+        WorkerPool& workers = getWorkerPool();
+        double traffic = getBaseTrafficFactor();
+
+        workers.parallelFor(matrix.rows, [&](int row, int) {
+            SearchWorkspace& workspace = SearchWorkspace::local();
+            SearchLabels& labels = workspace.labels[0];
+            int source = sources[row];
+            int remaining = distinctTargets;
+
+            labels.reset(n);
+            labels.update(source, 0, -1);
+            workspace.withHeaps(heapKind, [&](auto& heaps) {
+                auto& heap = heaps[0];
+                heap.clear();
+                heap.push(0.0, source);
+                while (!heap.empty() && remaining > 0) {
+                    double d;
+                    int u;
+                    heap.pop(d, u);
+                    if (d > labels.distance(u)) continue;
+                    if (isTarget[u]) remaining--;
+
+                    for (int e = network.edgeOffsets[u]; e < network.edgeOffsets[u + 1]; e++) {
+                        int v = network.edgeTargets[e];
+                        if (d + network.edgeWeights[e] < labels.distance(v)) {
+                            labels.update(v, d + network.edgeWeights[e], u);
+                            heap.push(d + network.edgeWeights[e], v);
+                        }
+                    }
+                }
+                heap.clear();
+            });
+
+            size_t base = static_cast<size_t>(row) * matrix.cols;
+            for (int col = 0; col < matrix.cols; col++) {
+                double d = labels.distance(targets[col]);
+                matrix.distanceKm[base + col] = d;
+                if (d < 1e18) matrix.travelMinutes[base + col] = (d / 20.0) * 60 * traffic;
+            }
+        });
+        return matrix;
+    }
+
+    // Answers every query on the worker pool; results[i] belongs to queries[i].
+    // Each query pins whichever snapshot is current when it starts.
+    // Rows without a departure time are priced with the base traffic factor,
+    // so they all use the same hour.
+    void answerBatch(const std::vector<BatchQuery>& queries, std::vector<BatchResult>& results) {
+        prepareSearch(searchMode);
+        for (const BatchQuery& query : queries) {
+            if (query.departMinute >= 0) {
+                ensureTrafficModel();
+                break;
+            }
+        }
+        results.assign(queries.size(), BatchResult());
+
+        WorkerPool& workers = getWorkerPool();
+        std::vector<SearchStats> statsByWorker(workers.size());
+        double traffic = getBaseTrafficFactor();
+
+        workers.parallelFor(static_cast<int>(queries.size()), [&](int i, int worker) {
+            const BatchQuery& query = queries[i];
+            auto snapshot = snapshots.pin();
+            const BusNetwork& network = snapshot->network;
+            if (query.start < 0 || query.end < 0 || std::max(query.start, query.end) >= network.size()) return;
+
+            thread_local std::vector<int> path;
+            double arrival = -1;
+            if (query.departMinute >= 0) {
+                arrival = searchTimeDependent(*snapshot, query.start, query.end, query.departMinute, path,
+                                              statsByWorker[worker]);
+            } else {
+                searchRoute(*snapshot, query.start, query.end, searchMode, path, statsByWorker[worker]);
+            }
+            if (path.empty()) return;
+
+            BatchResult& result = results[i];
+            for (size_t k = 1; k < path.size(); k++) {
+                result.distanceKm += network.distance(path[k - 1], path[k]);
+            }
+            result.stops = static_cast<int>(path.size());
+            result.travelMinutes = arrival >= 0 ? arrival - query.departMinute
+                                                : (result.distanceKm / 20.0) * 60 * traffic;
+            result.fare = directFare(network, query.start, query.end, query.student);
+        });
+
+        for (const SearchStats& stats : statsByWorker) totalSearch.add(stats);
+    }
+
+    WorkerPool& getWorkerPool() {
+        if (!workerPool) {
+            int threads = workerThreads > 0 ? workerThreads
+                                            : static_cast<int>(std::thread::hardware_concurrency());
+            workerPool.reset(new WorkerPool(std::max(threads, 1)));
+        }
+        return *workerPool;
+    }
+
+    void setWorkerThreads(int threads) {
+        workerThreads = threads;
+        workerPool.reset();
+    }
+
+    int getPlaceId(const std::string& name) const {
+        return network.findId(name);
+    }
+
+    std::string getPlaceName(int id) const {
+        return std::string(network.name(id));
+    }
+
+    // Loads landmarks.bin when it matches the current graph, otherwise picks
+    // landmarks in the background and saves the new table once adopted.
+    void ensureLandmarks(bool wait = true) {
+        while (!landmarkTable) {
+            if (!landmarkBuild.running()) {
+                std::shared_ptr<LandmarkTable> table = std::make_shared<LandmarkTable>();
+                if (table->load(LANDMARK_FILE, network.size(), network.fingerprint())) {
+                    std::cout << "📂 " << table->landmarkCount() << " landmarks loaded from " << LANDMARK_FILE << "\n";
+                    landmarkTable = table;
+                    publishSnapshot();
+                    return;
+                }
+                std::cout << "🧭 Selecting landmarks in the background...\n";
+                BusNetwork source = network;        // shares the arrays with the snapshot
+                int count = LANDMARK_COUNT;
+                HeapKind kind = heapKind;
+                landmarkBuild.start(graphGeneration,
+                                    [source, count, kind]() { return selectLandmarks(source, count, kind); });
+            }
+
+            std::shared_ptr<const LandmarkTable> built;
+            double millis = 0;
+            if (landmarkBuild.take(graphGeneration, wait, built, millis)) {
+                landmarkTable = built;
+                publishSnapshot();
+                std::cout << "🧭 Landmarks ready ✅ (" << built->landmarkCount() << " landmarks, "
+                          << static_cast<int>(millis) << " ms)\n";
+                if (built->isReady() && !built->save(LANDMARK_FILE)) {
+                    std::cout << "⚠️ Error: Could not save " << LANDMARK_FILE << "!\n";
+                }
+            } else if (!wait && landmarkBuild.running()) {
+                return;
+            }
+        }
+    }
+
+    // Farthest-point selection; unreachable places count as infinitely far,
+    // so every component gets a landmark before any is covered twice.
+    static std::shared_ptr<const LandmarkTable> selectLandmarks(const BusNetwork& network, int count, HeapKind kind) {
+        std::shared_ptr<LandmarkTable> table = std::make_shared<LandmarkTable>();
+        int n = network.size();
+        table->reset(n, network.fingerprint());
+        if (n == 0) return table;
+
+        std::vector<double> dist;
+        computeDistancesFrom(network, 0, dist, kind);
+        std::vector<double> nearest(n, 1e18);
+        int next = static_cast<int>(std::max_element(dist.begin(), dist.end()) - dist.begin());
+        for (int i = 0; i < count && i < n; i++) {
+            computeDistancesFrom(network, next, dist, kind);
+            table->addLandmark(next, dist);
+            for (int v = 0; v < n; v++) {
+                nearest[v] = std::min(nearest[v], dist[v]);
+            }
+            next = static_cast<int>(std::max_element(nearest.begin(), nearest.end()) - nearest.begin());
+            if (nearest[next] <= 0) break;
+        }
+        return table;
+    }
+
+    // Edge road classes are derived on first time-dependent query.
+    void ensureTrafficModel() {
+        if (trafficModel) return;
+        std::shared_ptr<TrafficModel> model = std::make_shared<TrafficModel>();
+        model->build(network);
+        trafficModel = model;
+        publishSnapshot();
+    }
+
+    // The nearest-stop tree is rebuilt on first use after each network change.
+    void ensureStopTree() {
+        if (stopTree) return;
+        std::shared_ptr<StopKdTree> tree = std::make_shared<StopKdTree>();
+        tree->build(network);
+        stopTree = tree;
+    }
+
+    // Up to k stops nearest to (lat, lon) as (km, id), nearest first.
+    void nearestStops(double lat, double lon, size_t k, std::vector<std::pair<double, int>>& found) {
+        ensureStopTree();
+        stopTree->nearest(lat, lon, k, found);
+    }
+
+    // Accepts "lat,lon" in decimal degrees.
+    static bool parseCoordinates(std::string_view text, double& lat, double& lon) {
+        size_t comma = text.find(',');
+        if (comma == std::string_view::npos) return false;
+        const char* end = text.data() + comma;
+        auto parsed = std::from_chars(text.data(), end, lat);
+        if (parsed.ec != std::errc() || parsed.ptr != end) return false;
+        end = text.data() + text.size();
+        parsed = std::from_chars(text.data() + comma + 1, end, lon);
+        if (parsed.ec != std::errc() || parsed.ptr != end) return false;
+        return std::fabs(lat) <= 90 && std::fabs(lon) <= 180;
+    }
+
+    // Id of the named place, or of the stop nearest to "lat,lon"; -1 if neither.
+    int resolveStop(const std::string& text) {
+        int id = network.findId(text);
+        double lat, lon;
+        if (id >= 0 || !parseCoordinates(text, lat, lon)) return id;
+        std::vector<std::pair<double, int>> found;
+        nearestStops(lat, lon, 1, found);
+        return found.empty() ? -1 : found[0].second;
+    }
+
+    // Congestion multiplier for riding a -> b from the given minute of the day.
+    double trafficFactorAt(int a, int b, double minute) {
+        ensureTrafficModel();
+        for (int e = network.edgeOffsets[a]; e < network.edgeOffsets[a + 1]; e++) {
+            if (network.edgeTargets[e] == b) return TrafficProfiles::factor(trafficModel->profileOf(e), minute);
+        }
+        return TrafficProfiles::factor(TrafficProfiles::Ring, minute);
+    }
+
+    int getEdgeCount() const {
+        return static_cast<int>(network.edgeTargets.size());
+    }
+
+    // Minutes after midnight on the local clock.
+    static double currentMinute() {
+        time_t now = time(0);
+        struct tm* timeinfo = localtime(&now);
+        return timeinfo->tm_hour * 60 + timeinfo->tm_min;
+    }
 
-        while (file >> name >> lat >> lon) {
-            places[name] = std::make_pair(lat, lon);
-            count++;
+    // Accepts "HH:MM" (24 hour) or "now".
+    static bool parseClock(const std::string& text, double& minute) {
+        if (text == "now") {
+            minute = currentMinute();
+            return true;
         }
+        int hours = 0, minutes = 0;
+        const char* end = text.data() + text.size();
+        auto parsed = std::from_chars(text.data(), end, hours);
+        if (parsed.ec != std::errc() || parsed.ptr == end || *parsed.ptr != ':') return false;
+        parsed = std::from_chars(parsed.ptr + 1, end, minutes);
+        if (parsed.ec != std::errc() || parsed.ptr != end) return false;
+        if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59) return false;
+        minute = hours * 60 + minutes;
+        return true;
+    }
 
-        std::cout << "📂 File theke " << count << " ti location load kora hoyeche.\n";
-        file.close();
+    static std::string formatClock(double minute) {
+        int total = static_cast<int>(std::lround(minute)) % 1440;
+        char text[8];
+        std::snprintf(text, sizeof(text), "%02d:%02d", total / 60, total % 60);
+        return text;
     }
 
-    double calculateDistance(double lat1, double lon1, double lat2, double lon2) {
-        const double R = 6371.0;
-        double dLat = (lat2 - lat1) * 3.14159 / 180.0;
-        double dLon = (lon2 - lon1) * 3.14159 / 180.0;
+    // The hierarchy is preprocessed in the background on first use after
+    // each network change; wait blocks until it has been published.
+    void ensureHierarchy(bool wait = true) {
+        while (!hierarchy) {
+            if (!hierarchyBuild.running()) {
+                std::cout << "⚡ Preprocessing contraction hierarchy in the background...\n";
+                BusNetwork source = network;        // shares the arrays with the snapshot
+                hierarchyBuild.start(graphGeneration, [source]() {
+                    std::shared_ptr<ContractionHierarchy> built = std::make_shared<ContractionHierarchy>();
+                    built->build(source);
+                    return std::shared_ptr<const ContractionHierarchy>(built);
+                });
+            }
 
-        double a = sin(dLat/2) * sin(dLat/2) +
-                   cos(lat1 * 3.14159/180.0) * cos(lat2 * 3.14159/180.0) * sin(dLon/2) * sin(dLon/2);
-        double c = 2 * atan2(sqrt(a), sqrt(1-a));
-        return R * c;
+            std::shared_ptr<const ContractionHierarchy> built;
+            double millis = 0;
+            if (hierarchyBuild.take(graphGeneration, wait, built, millis)) {
+                Metrics::record(Metrics::Build, static_cast<uint64_t>(millis * 1e6));
+                hierarchy = built;
+                publishSnapshot();
+                std::cout << "⚡ Contraction hierarchy ready ✅ (" << hierarchy->getShortcutCount() << " shortcuts, "
+                          << std::fixed << std::setprecision(1) << hierarchy->getBuildMillis() << " ms)\n";
+                std::cout.unsetf(std::ios::fixed);
+                std::cout << std::setprecision(6);
+            } else if (!wait && hierarchyBuild.running()) {
+                return;
+            }
+        }
     }
 
-    void buildGraph() {
-        std::cout << "🔄 Building route network...";
-        graph.clear();
-        for (auto& A : places) {
-            for (auto& B : places) {
-                if (A.first != B.first) {
-                    double dist = calculateDistance(A.second.first, A.second.second,
-                                                  B.second.first, B.second.second);
-                    if (dist < 5.0) {
-                        graph[A.first].push_back(std::make_pair(B.first, dist));
-                    }
-                }
+    // One-to-many distances from a few sources to every place: calculateDistance
+    // against the GeoKernel scalar and AVX2 paths, plus the threshold mask.
+    void benchmarkDistanceKernel() {
+        int n = network.size();
+        int sources = std::min(n, 32);
+        if (sources == 0) return;
+
+        std::vector<double> reference(n), chords(n), kernelKm(n);
+        std::vector<int> hits(n);
+        double maxError = 0.0;
+        volatile double sink = 0.0;     // keeps the timed loops from being optimised away
+        double pairs = static_cast<double>(sources) * n;
+        using Clock = std::chrono::steady_clock;
+        auto nanosPerPair = [pairs](Clock::time_point started) {
+            return std::chrono::duration<double, std::nano>(Clock::now() - started).count() / pairs;
+        };
+
+        auto started = Clock::now();
+        for (int s = 0; s < sources; s++) {
+            for (int t = 0; t < n; t++) {
+                reference[t] = calculateDistance(network.latitudes[s], network.longitudes[s],
+                                                 network.latitudes[t], network.longitudes[t]);
             }
+            sink = sink + reference[n - 1];
         }
-        std::cout << " ✅ Done! (" << graph.size() << " locations connected)\n";
-    }
+        double scalarNanos = nanosPerPair(started);
 
-    std::vector<std::string> findShortestPath(const std::string& start, const std::string& end) {
-        if (places.find(start) == places.end() || places.find(end) == places.end()) {
-            return std::vector<std::string>();
+        double kernelNanos[2] = {0, 0};
+        for (int path = 0; path < 2; path++) {
+            bool avx2 = (path == 1);
+            if (avx2 && !GeoKernel::hasAvx2()) break;
+            started = Clock::now();
+            for (int s = 0; s < sources; s++) {
+                GeoKernel::chordSquared(network.unitX[s], network.unitY[s], network.unitZ[s], network.unitX.data(),
+                                        network.unitY.data(), network.unitZ.data(), n, chords.data(), avx2);
+                for (int t = 0; t < n; t++) kernelKm[t] = GeoKernel::chordToKm(chords[t]);
+                sink = sink + kernelKm[n - 1];
+            }
+            kernelNanos[path] = nanosPerPair(started);
         }
 
-        std::map<std::string, double> dist;
-        std::map<std::string, std::string> prev;
+        double limit = GeoKernel::radiusToChordSquared(linkRadiusKm);
+        started = Clock::now();
+        for (int s = 0; s < sources; s++) {
+            sink = sink + GeoKernel::within(network.unitX[s], network.unitY[s], network.unitZ[s], network.unitX.data(),
+                                      network.unitY.data(), network.unitZ.data(), n, limit, hits.data(),
+                                      chords.data());
+        }
+        double maskNanos = nanosPerPair(started);
 
-        for (auto& place : places) {
-            dist[place.first] = 1e18;
+        for (int s = 0; s < sources; s++) {
+            for (int t = 0; t < n; t++) {
+                double expected = calculateDistance(network.latitudes[s], network.longitudes[s],
+                                                    network.latitudes[t], network.longitudes[t]);
+                maxError = std::max(maxError, std::fabs(network.distance(s, t) - expected));
+            }
         }
-        dist[start] = 0;
 
-        using Pair = std::pair<double, std::string>;
-        std::priority_queue<Pair, std::vector<Pair>, std::greater<Pair>> pq;
-        pq.push(std::make_pair(0, start));
+        std::cout << "\n📏 DISTANCE KERNEL (" << sources << " x " << n << " pairs)\n";
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "calculateDistance:  " << scalarNanos << " ns/pair\n";
+        std::cout << "Kernel (scalar):    " << kernelNanos[0] << " ns/pair ("
+                  << (kernelNanos[0] > 0 ? scalarNanos / kernelNanos[0] : 0.0) << "x)\n";
+        if (GeoKernel::hasAvx2()) {
+            std::cout << "Kernel (AVX2):      " << kernelNanos[1] << " ns/pair ("
+                      << (kernelNanos[1] > 0 ? scalarNanos / kernelNanos[1] : 0.0) << "x)\n";
+        } else {
+            std::cout << "Kernel (AVX2):      not supported on this CPU\n";
+        }
+        std::cout << "Radius mask:        " << maskNanos << " ns/pair ("
+                  << (maskNanos > 0 ? scalarNanos / maskNanos : 0.0) << "x)\n";
+        std::cout << std::scientific << std::setprecision(2)
+                  << "Max |error|:        " << maxError << " km\n";
+        std::cout.unsetf(std::ios::scientific);
+        std::cout << std::setprecision(6);
+    }
 
-        while (!pq.empty()) {
-            Pair top = pq.top();
-            double currentDist = top.first;
-            std::string u = top.second;
-            pq.pop();
+    // Times the same random queries through every search mode.
+    void showRoutingReport(int samples = 200) {
+        int n = network.size();
+        if (n < 2) {
+            std::cout << "❌ Not enough places for a routing report!\n";
+            return;
+        }
+        ensureHierarchy();
 
-            if (u == end) break;
-            if (currentDist > dist[u]) continue;
+        // Own stream, so a given --seed always times the same queries.
+        Xoshiro256 rng = RandomService::stream(RandomService::Report);
+        std::vector<std::pair<int, int>> queries;
+        for (int i = 0; i < samples; i++) {
+            int a = static_cast<int>(rng.below(n));
+            queries.push_back(std::make_pair(a, static_cast<int>(rng.below(n))));
+        }
 
-            if (graph.find(u) != graph.end()) {
-                for (auto& edge : graph[u]) {
-                    std::string v = edge.first;
-                    double weight = edge.second;
+        SearchStats savedLast = lastSearch;
+        SearchStats savedTotal = totalSearch;
+        ensureLandmarks();
+        const SearchMode modes[] = {SearchMode::Dijkstra, SearchMode::AStar, SearchMode::Landmarks,
+                                    SearchMode::Bidirectional, SearchMode::ContractionHierarchy};
+        double baselineMicros = 0;
 
-                    if (dist[u] + weight < dist[v]) {
-                        dist[v] = dist[u] + weight;
-                        prev[v] = u;
-                        pq.push(std::make_pair(dist[v], v));
-                    }
-                }
+        std::cout << "\n⚡ ROUTING ENGINE REPORT (" << samples << " random queries)\n";
+        std::cout << std::string(60, '-') << "\n";
+        std::cout << std::left << std::setw(16) << "Mode" << std::setw(14) << "us/query"
+                  << std::setw(16) << "settled/query" << "Speedup\n";
+        std::cout << std::string(60, '-') << "\n";
+        for (SearchMode mode : modes) {
+            totalSearch = SearchStats();
+            auto started = std::chrono::steady_clock::now();
+            for (auto& q : queries) {
+                findShortestPath(q.first, q.second, mode);
             }
-        }
+            double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count()
+                            / samples;
+            if (mode == SearchMode::Dijkstra) baselineMicros = micros;
 
-        std::vector<std::string> path;
-        if (dist[end] >= 1e18) {
-            return path;
+            std::cout << std::left << std::fixed << std::setprecision(2)
+                      << std::setw(16) << searchModeName(mode)
+                      << std::setw(14) << micros
+                      << std::setw(16) << static_cast<double>(totalSearch.settledNodes) / samples
+                      << (micros > 0 ? baselineMicros / micros : 0.0) << "x\n";
         }
+        std::cout << std::string(60, '-') << "\n";
+        std::cout << "CH preprocessing: " << hierarchy->getBuildMillis() << " ms, "
+                  << hierarchy->getShortcutCount() << " shortcuts\n";
 
-        std::string current = end;
-        while (current != start) {
-            path.insert(path.begin(), current);
-            if (prev.find(current) == prev.end()) break;
-            current = prev[current];
+        // Same Dijkstra queries through each priority queue.
+        HeapKind savedHeap = heapKind;
+        const HeapKind heaps[] = {HeapKind::Binary, HeapKind::Quad, HeapKind::Radix};
+        std::cout << "\n🧮 PRIORITY QUEUES (dijkstra)\n";
+        std::cout << std::string(72, '-') << "\n";
+        std::cout << std::left << std::setw(10) << "Heap" << std::setw(12) << "us/query"
+                  << std::setw(16) << "pushes/query" << std::setw(16) << "pops/query" << "stale pops\n";
+        std::cout << std::string(72, '-') << "\n";
+        for (HeapKind kind : heaps) {
+            heapKind = kind;
+            totalSearch = SearchStats();
+            auto started = std::chrono::steady_clock::now();
+            for (auto& q : queries) {
+                findShortestPath(q.first, q.second, SearchMode::Dijkstra);
+            }
+            double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count()
+                            / samples;
+            double pops = static_cast<double>(totalSearch.heapPops);
+            std::cout << std::left << std::setw(10) << heapKindName(kind)
+                      << std::setw(12) << micros
+                      << std::setw(16) << totalSearch.heapPushes / static_cast<double>(samples)
+                      << std::setw(16) << pops / samples
+                      << (pops > 0 ? 100.0 * totalSearch.stalePops / pops : 0.0) << "%\n";
         }
-        path.insert(path.begin(), start);
+        heapKind = savedHeap;
+        std::cout << std::string(72, '-') << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+        benchmarkDistanceKernel();
 
-        return path;
+        lastSearch = savedLast;
+        totalSearch = savedTotal;
     }
 
-    double getTrafficFactor() {
+    void setSearchMode(SearchMode mode) {
+        searchMode = mode;
+        prepareSearch(mode, false);     // start preprocessing while the user types
+    }
+
+    SearchMode getSearchMode() const {
+        return searchMode;
+    }
+
+    const SearchStats& getLastSearchStats() const {
+        return lastSearch;
+    }
+
+    double getBaseTrafficFactor() {
         time_t now = time(0);
         struct tm* timeinfo = localtime(&now);
         int hour = timeinfo->tm_hour;
 
-        double baseTraffic;
         if ((hour >= 8 && hour < 10) || (hour >= 17 && hour < 19)) {
-            baseTraffic = 1.4;
+            return 1.4;
         } else if (hour >= 23 || hour < 6) {
-            baseTraffic = 1.0;
-        } else {
-            baseTraffic = 1.2;
+            return 1.0;
         }
+        return 1.2;
+    }
 
-        return baseTraffic + (rand() % 20) / 100.0;
+    double getTrafficFactor() {
+        return getBaseTrafficFactor() + RandomService::local().below(20) / 100.0;
     }
 
     std::string getTrafficColor(double traffic) {
@@ -211,9 +4571,11 @@ public:
     }
 
     double getTimeFactor() {
-        time_t now = time(0);
-        struct tm* timeinfo = localtime(&now);
-        int hour = timeinfo->tm_hour;
+        return getTimeFactor(currentMinute());
+    }
+
+    double getTimeFactor(double minute) {
+        int hour = static_cast<int>(std::fmod(minute, 1440.0) / 60);
 
         if (hour >= 23 || hour < 6) return 1.25;
         if ((hour >= 8 && hour < 10) || (hour >= 17 && hour < 20)) return 1.15;
@@ -222,6 +4584,7 @@ public:
 
     void updateWeather() {
         currentWeather = weatherSystem.getRandomWeather();
+        publishSnapshot();
         std::cout << "🌤️  Weather Updated: " << weatherSystem.getWeatherColor(currentWeather)
                   << " " << currentWeather << "\n";
     }
@@ -234,7 +4597,7 @@ public:
         std::cout << "Enter place name (No spaces, e.g., Rampura): ";
         std::cin >> name;
 
-        if (places.find(name) != places.end()) {
+        if (placeExists(name)) {
             std::cout << "❌ Place already exists!\n";
             return;
         }
@@ -244,9 +4607,7 @@ public:
         std::cout << "Enter longitude (e.g., 90.4175): ";
         std::cin >> lon;
 
-        places[name] = std::make_pair(lat, lon);
-
-        std::ofstream file("locations.txt", std::ios::app);
+        std::ofstream file(LOCATIONS_FILE, std::ios::app);
         if (file.is_open()) {
             file << name << " " << lat << " " << lon << "\n";
             file.close();
@@ -255,7 +4616,7 @@ public:
             std::cout << "⚠️ Error: Could not save to file!\n";
         }
 
-        buildGraph();
+        addPlaces({PlaceEntry{name, lat, lon}});
         std::cout << "✅ Place '" << name << "' added and saved!\n";
     }
 
@@ -280,14 +4641,15 @@ public:
             system(command.c_str());
         }
         else if (mapChoice == 2) {
-            showAllPlaces();
+            showPlacePrompt();
             std::string name;
             std::cout << "Enter place name to view: ";
             std::cin >> name;
 
-            if (places.find(name) != places.end()) {
-                double lat = places[name].first;
-                double lon = places[name].second;
+            int id = resolvePlace(name) ? network.findId(name) : -1;
+            if (id >= 0) {
+                double lat = network.latitudes[id];
+                double lon = network.longitudes[id];
                 url = "https://www.google.com/maps/search/?api=1&query=" +
                       std::to_string(lat) + "," + std::to_string(lon);
 
@@ -300,17 +4662,23 @@ public:
         }
         else if (mapChoice == 3) {
             std::string start, end;
-            showAllPlaces();
+            showPlacePrompt();
             std::cout << "Enter START: ";
             std::cin >> start;
-            std::cout << "Enter END: ";
-            std::cin >> end;
+            bool found = resolvePlace(start);
+            if (found) {
+                std::cout << "Enter END: ";
+                std::cin >> end;
+                found = resolvePlace(end);
+            }
 
-            if (places.find(start) != places.end() && places.find(end) != places.end()) {
-                double lat1 = places[start].first;
-                double lon1 = places[start].second;
-                double lat2 = places[end].first;
-                double lon2 = places[end].second;
+            int startId = found ? network.findId(start) : -1;
+            int endId = found ? network.findId(end) : -1;
+            if (startId >= 0 && endId >= 0) {
+                double lat1 = network.latitudes[startId];
+                double lon1 = network.longitudes[startId];
+                double lat2 = network.latitudes[endId];
+                double lon2 = network.longitudes[endId];
 
                 url = "https://www.google.com/maps/dir/" +
                       std::to_string(lat1) + "," + std::to_string(lon1) + "/" +
@@ -325,16 +4693,141 @@ public:
         }
     }
 
+    // Up to five routes, each priced and timed like the main route.
+    void showAlternativeRoutes() {
+        std::string start, end, departure;
+        char student;
+        int count;
+        showPlacePrompt();
+
+        std::cout << "\nEnter START location: ";
+        std::cin >> start;
+        if (!resolvePlace(start)) {
+            std::cout << "❌ Error: Invalid location name!\n";
+            return;
+        }
+        std::cout << "Enter END location: ";
+        std::cin >> end;
+        if (!resolvePlace(end)) {
+            std::cout << "❌ Error: Invalid location name!\n";
+            return;
+        }
+        std::cout << "How many routes? (1-5): ";
+        std::cin >> count;
+        count = std::clamp(count, 1, 5);
+        std::cout << "Student discount? (y/n): ";
+        std::cin >> student;
+        std::cout << "Departure time (HH:MM or now): ";
+        std::cin >> departure;
+        double departMinute;
+        if (!parseClock(departure, departMinute)) {
+            std::cout << "⚠️ Invalid time, using now\n";
+            departMinute = currentMinute();
+        }
+
+        std::vector<std::vector<std::string>> routes = findAlternativeRoutes(start, end, count);
+        if (routes.empty()) {
+            std::cout << "❌ No route found between " << start << " and " << end << "!\n";
+            return;
+        }
+        for (size_t i = 0; i < routes.size(); i++) {
+            std::cout << "\n🔀 Option " << i + 1 << " of " << routes.size() << "\n";
+            calculateFare(routes[i], (student == 'y' || student == 'Y'), departMinute);
+        }
+    }
+
+    void showNearestStops() {
+        std::string location;
+        int count;
+        std::cout << "\nEnter your location (lat,lon, e.g. 23.7509,90.3935): ";
+        std::cin >> location;
+        double lat, lon;
+        if (!parseCoordinates(location, lat, lon)) {
+            std::cout << "❌ Invalid coordinates!\n";
+            return;
+        }
+        std::cout << "How many stops? (1-20): ";
+        std::cin >> count;
+        count = std::clamp(count, 1, 20);
+
+        std::vector<std::pair<double, int>> found;
+        nearestStops(lat, lon, count, found);
+        std::cout << "\n📡 Nearest stops:\n";
+        std::cout << std::string(35, '-') << "\n";
+        std::cout << std::fixed << std::setprecision(2);
+        for (size_t i = 0; i < found.size(); i++) {
+            std::cout << std::setw(2) << i + 1 << ". " << std::left << std::setw(20) << network.name(found[i].second)
+                      << std::right << std::setw(7) << found[i].first << " km\n";
+        }
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+        std::cout << std::string(35, '-') << "\n";
+    }
+
+    // Stops reachable within a time budget leaving now (or a km budget),
+    // nearest first, and the outline around them.
+    void showReachableStops() {
+        std::string start, budgetText;
+        showPlacePrompt();
+
+        std::cout << "\nEnter START location: ";
+        std::cin >> start;
+        if (!resolvePlace(start)) {
+            std::cout << "❌ Error: Invalid location name!\n";
+            return;
+        }
+        std::cout << "Budget (minutes, e.g. 30, or km, e.g. 5km): ";
+        std::cin >> budgetText;
+        bool byDistance = budgetText.size() > 2 && budgetText.compare(budgetText.size() - 2, 2, "km") == 0;
+        double budget = std::atof(budgetText.c_str());
+        if (budget <= 0) {
+            std::cout << "❌ Invalid budget!\n";
+            return;
+        }
+
+        double departMinute = byDistance ? -1 : currentMinute();
+        std::vector<ReachableStop> reached;
+        findReachable(network.findId(start), budget, departMinute, reached);
+        std::vector<int> hull;
+        reachableOutline(reached, hull);
+
+        const char* unit = byDistance ? " km" : " min";
+        std::cout << "\n" << std::string(50, '-') << "\n";
+        std::cout << "🕒 " << reached.size() << " stops within " << budget << unit << " of " << start;
+        if (!byDistance) std::cout << " (leaving " << formatClock(departMinute) << ")";
+        std::cout << "\n" << std::string(50, '-') << "\n";
+        const size_t SHOWN = 20;
+        std::cout << std::fixed << std::setprecision(1);
+        for (size_t i = 0; i < reached.size() && i < SHOWN; i++) {
+            std::cout << std::left << std::setw(20) << network.name(reached[i].id) << std::right
+                      << std::setw(8) << reached[i].cost << unit << "\n";
+        }
+        if (reached.size() > SHOWN) std::cout << "... and " << reached.size() - SHOWN << " more\n";
+
+        std::cout << "\n📐 Outline (" << hull.size() << " stops, about " << outlineAreaKm2(hull) << " km²):\n";
+        std::cout << std::setprecision(5);
+        for (int id : hull) {
+            std::cout << "  " << network.name(id) << " (" << network.latitudes[id] << ", "
+                      << network.longitudes[id] << ")\n";
+        }
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+        std::cout << std::string(50, '-') << "\n";
+    }
+
     void viewRouteSequence() {
         std::string start, end;
-        showAllPlaces();
+        showPlacePrompt();
 
         std::cout << "\nEnter START location: ";
         std::cin >> start;
+        if (!resolvePlace(start)) {
+            std::cout << "❌ Error: Invalid location name!\n";
+            return;
+        }
         std::cout << "Enter END location: ";
         std::cin >> end;
-
-        if (!placeExists(start) || !placeExists(end)) {
+        if (!resolvePlace(end)) {
             std::cout << "❌ Error: Invalid location name!\n";
             return;
         }
@@ -359,7 +4852,23 @@ public:
         std::cout << "\n\n" << std::string(50, '-') << "\n";
     }
 
-    void calculateFare(const std::vector<std::string>& path, bool studentDiscount = false) {
+    // Fare is charged on the straight-line distance between the two ends.
+    double directFare(const BusNetwork& places, int startId, int endId, bool studentDiscount) const {
+        double fare = places.distance(startId, endId) * BASE_FARE_PER_KM;
+        if (studentDiscount) {
+            fare *= 0.5;
+        }
+        if (fare < 10.0) fare = 10.0; // Min fare
+        return fare;
+    }
+
+    // With a departure minute, each segment is timed by its road's traffic
+    // profile at the moment the bus reaches it; otherwise by the citywide
+    // factor for the current hour. The route table goes to sink, or to
+    // stdout when none is given.
+    void calculateFare(const std::vector<std::string>& path, bool studentDiscount = false,
+                       double departMinute = -1, RouteSink* sink = nullptr) {
+        PhaseTimer timer(Metrics::Fare);
         if (path.size() < 2) {
             std::cout << "❌ No valid route found!\n";
             return;
@@ -372,16 +4881,13 @@ public:
         // ==========================================
         // CHANGE: FARE CALCULATION ON DIRECT DISTANCE
         // ==========================================
-        auto startNode = places[path.front()];
-        auto endNode = places[path.back()];
-        double directDistance = calculateDistance(startNode.first, startNode.second, endNode.first, endNode.second);
+        int startId = network.findId(path.front());
+        int endId = network.findId(path.back());
+        double directDistance = network.distance(startId, endId);
 
-        double totalFare = directDistance * BASE_FARE_PER_KM;
+        double totalFare = directFare(network, startId, endId, studentDiscount);
 
-        if (studentDiscount) {
-            totalFare *= 0.5;
-        }
-        if (totalFare < 10.0) totalFare = 10.0; // Min fare
+        double clock = departMinute;
 
         // Loop for generating Sequence Details (Time, Traffic, Path Distance)
         for (size_t i = 0; i < path.size() - 1; i++) {
@@ -389,14 +4895,21 @@ public:
             segment.from = path[i];
             segment.to = path[i + 1];
 
-            auto A = places[segment.from];
-            auto B = places[segment.to];
+            int a = network.findId(segment.from);
+            int b = network.findId(segment.to);
 
-            segment.distance = calculateDistance(A.first, A.second, B.first, B.second);
-            segment.traffic = getTrafficFactor();
-            segment.timeFactor = getTimeFactor();
+            segment.distance = network.distance(a, b);
+            if (departMinute >= 0) {
+                segment.traffic = trafficFactorAt(a, b, clock);
+                segment.timeFactor = getTimeFactor(clock);
+                clock += (segment.distance / 20.0) * 60 * segment.traffic;
+            } else {
+                segment.traffic = getTrafficFactor();
+                segment.timeFactor = getTimeFactor();
+            }
             segment.weatherImpact = weatherSystem.getWeatherImpact(currentWeather);
             segment.trafficColor = getTrafficColor(segment.traffic);
+            segment.trafficStatus = getTrafficStatus(segment.traffic);
 
             segment.fare = 0; // Segment wise fare nai, tai 0 set kora holo
 
@@ -406,69 +4919,50 @@ public:
             routeDistance += segment.distance;
             totalTime += segment.travelTime;
         }
+        if (departMinute >= 0) {
+            // Same clock as the arrival line, not the truncated segment sum.
+            totalTime = static_cast<int>(std::lround(clock)) - static_cast<int>(std::lround(departMinute));
+        }
 
-        displayRouteTable(path, segments, routeDistance, totalFare, totalTime, studentDiscount, directDistance);
+        displayRouteTable(path, segments, routeDistance, totalFare, totalTime, studentDiscount, directDistance, sink,
+                          departMinute, clock);
     }
 
+    // The report goes to sink, or to the console through consoleBuffer.
     void displayRouteTable(const std::vector<std::string>& path,
                           const std::vector<SegmentInfo>& segments,
                           double totalDistance, double totalFare,
-                          int totalTime, bool studentDiscount, double directDistance) {
-
-        std::cout << "\n" << std::string(80, '=') << "\n";
-        std::cout << "                     🚌 DHAKA BUS ROUTE PLANNER\n";
-        std::cout << std::string(80, '=') << "\n\n";
-
-        std::cout << "💰 Base Rate: " << BASE_FARE_PER_KM << " per km (Direct)\n";
-        std::cout << "🌤️  Current Weather: " << weatherSystem.getWeatherColor(currentWeather)
-                  << " " << currentWeather << "\n";
-
-        std::cout << "📍 Route: ";
-        for (size_t i = 0; i < path.size(); i++) {
-            std::cout << path[i];
-            if (i != path.size() - 1) std::cout << " → ";
-        }
-        std::cout << "\n\n";
-
-        std::cout << std::string(100, '-') << "\n";
-        std::cout << std::left << std::setw(20) << "Segment"
-                  << std::setw(12) << "Distance"
-                  << std::setw(10) << "Traffic"
-                  << std::setw(12) << "Time Factor"
-                  << std::setw(10) << "Weather"
-                  << std::setw(10) << "Time"
-                  << std::setw(15) << "Fare(৳)"
-                  << "Status\n";
-        std::cout << std::string(100, '-') << "\n";
-
-        for (const auto& segment : segments) {
-            std::string segmentName = segment.from + "→" + segment.to;
-
-            std::cout << std::left << std::setw(20) << segmentName
-                      << std::fixed << std::setprecision(2)
-                      << std::setw(12) << segment.distance
-                      << std::setw(10) << segment.traffic
-                      << std::setw(12) << segment.timeFactor
-                      << std::setw(10) << segment.weatherImpact
-                      << std::setw(10) << (std::to_string(segment.travelTime) + "min")
-                      << std::setw(15) << "-"  // Segment fare show korbe na
-                      << segment.trafficColor << " " << getTrafficStatus(segment.traffic) << "\n";
-        }
-
-        std::cout << std::string(100, '=') << "\n";
-        std::cout << "📊 JOURNEY SUMMARY:\n";
-        std::cout << std::string(50, '-') << "\n";
-        std::cout << "Route Distance:  " << std::setw(10) << totalDistance << " km (Actual Path)\n";
-        std::cout << "Direct Distance: " << std::setw(10) << directDistance << " km (For Fare)\n";
-        std::cout << "Total Fare:      " << std::setw(10) << "৳ " << totalFare;
-        if(studentDiscount) std::cout << " (Student Fare Applied)";
-        std::cout << "\n";
-        std::cout << "Total Time:      " << std::setw(10) << totalTime << " minutes\n";
-        std::cout << "Segments:        " << std::setw(10) << segments.size() << "\n";
-
-        std::cout << std::string(50, '-') << "\n";
+                          int totalTime, bool studentDiscount, double directDistance,
+                          RouteSink* sink = nullptr, double departMinute = -1, double arrivalMinute = -1) {
+        std::string weatherIcon = weatherSystem.getWeatherColor(currentWeather);
+        RouteRecord route;
+        route.from = path.front();
+        route.to = path.back();
+        route.student = studentDiscount;
+        route.stops = static_cast<int>(path.size());
+        route.distanceKm = totalDistance;
+        route.directKm = directDistance;
+        route.travelMinutes = totalTime;
+        route.fare = totalFare;
+        route.farePerKm = BASE_FARE_PER_KM;
+        route.weather = currentWeather;
+        route.weatherIcon = weatherIcon;
+        route.path = &path;
+        route.segments = &segments;
+        std::string departure, arrival;
+        if (departMinute >= 0) {
+            departure = formatClock(departMinute);
+            arrival = formatClock(arrivalMinute);
+            route.departure = departure;
+            route.arrival = arrival;
+        }
 
-        std::cout << "\nTraffic Legend: 🟢 Smooth  🟡 Light  🟠 Moderate  🔴 Heavy\n";
+        if (sink) {
+            sink->write(route);
+            return;
+        }
+        consoleTable.write(route);
+        consoleTable.flush();
     }
 
     std::string getTrafficStatus(double traffic) {
@@ -479,17 +4973,91 @@ public:
     }
 
     void showAllPlaces() {
-        std::cout << "\n📍 AVAILABLE LOCATIONS (" << places.size() << " places):\n";
+        std::cout << "\n📍 AVAILABLE LOCATIONS (" << network.size() << " places):\n";
         std::cout << std::string(35, '-') << "\n";
         int count = 1;
-        for (auto& place : places) {
-            std::cout << std::setw(2) << count++ << ". " << place.first << "\n";
+        for (int id : network.sortedIds) {
+            std::cout << std::setw(2) << count++ << ". " << network.name(id) << "\n";
         }
         std::cout << std::string(35, '-') << "\n";
     }
 
     bool placeExists(const std::string& name) {
-        return places.find(name) != places.end();
+        return network.findId(name) >= 0;
+    }
+
+    // Lists every place on small networks; on large ones only explains how
+    // names can be typed.
+    void showPlacePrompt() {
+        if (network.size() <= PLACE_LIST_LIMIT) {
+            showAllPlaces();
+            return;
+        }
+        std::cout << "\n📍 " << network.size() << " places. Type a name, the start of one ending in *"
+                  << " (e.g. Gul*), a close spelling, or lat,lon.\n";
+    }
+
+    // Turns what the user typed into an exact place name. "lat,lon" snaps to
+    // the nearest stop. Unknown names are
+    // completed as a prefix and matched against close spellings; a single
+    // candidate is taken, several are offered as a numbered list. Returns
+    // false when nothing was chosen.
+    bool resolvePlace(std::string& name) {
+        if (placeExists(name)) return true;
+
+        double lat, lon;
+        if (parseCoordinates(name, lat, lon)) {
+            std::vector<std::pair<double, int>> found;
+            nearestStops(lat, lon, 1, found);
+            if (found.empty()) return false;
+            std::cout << "📍 Nearest stop: " << network.name(found[0].second) << " ("
+                      << std::fixed << std::setprecision(2) << found[0].first << " km away)\n";
+            std::cout.unsetf(std::ios::fixed);
+            std::cout << std::setprecision(6);
+            name = std::string(network.name(found[0].second));
+            return true;
+        }
+
+        std::string_view typed(name);
+        bool prefixOnly = !typed.empty() && typed.back() == '*';
+        if (prefixOnly) typed.remove_suffix(1);
+
+        std::vector<int> candidates;
+        network.completePrefix(typed, PLACE_SUGGESTIONS, candidates);
+        if (!prefixOnly && candidates.size() != 1) {
+            std::vector<std::pair<int, int>> matches;
+            network.fuzzyFind(typed, typed.size() <= 4 ? 1 : 2, PLACE_SUGGESTIONS, matches);
+            for (const auto& match : matches) {
+                if (candidates.size() >= PLACE_SUGGESTIONS) break;
+                if (std::find(candidates.begin(), candidates.end(), match.second) == candidates.end()) {
+                    candidates.push_back(match.second);
+                }
+            }
+        }
+
+        if (candidates.empty()) {
+            std::cout << "❌ No place matches " << name << "\n";
+            return false;
+        }
+        if (candidates.size() == 1) {
+            name = std::string(network.name(candidates[0]));
+            std::cout << "🔎 Using " << name << "\n";
+            return true;
+        }
+
+        std::cout << "🔎 Did you mean:\n";
+        for (size_t i = 0; i < candidates.size(); i++) {
+            std::cout << "  " << i + 1 << ". " << network.name(candidates[i]) << "\n";
+        }
+        std::cout << "Choose (1-" << candidates.size() << ", 0 to cancel): ";
+        size_t pick = 0;
+        if (!(std::cin >> pick) && !std::cin.eof()) {
+            std::cin.clear();
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        if (pick < 1 || pick > candidates.size()) return false;
+        name = std::string(network.name(candidates[pick - 1]));
+        return true;
     }
 
     void showWeatherInfo() {
@@ -505,16 +5073,404 @@ public:
     void showSystemInfo() {
         std::cout << "\n📊 SYSTEM INFORMATION\n";
         std::cout << std::string(40, '-') << "\n";
-        std::cout << "Total Locations: " << places.size() << "\n";
-        std::cout << "Connected Routes: " << graph.size() << "\n";
+        std::cout << "Total Locations: " << network.size() << "\n";
+        std::cout << "Connected Routes: " << network.connectedCount() << "\n";
+        std::cout << "Link Radius: " << linkRadiusKm << " km\n";
+        std::cout << "Search Mode: " << searchModeName(searchMode) << " (" << heapKindName(heapKind) << " heap)\n";
+        std::cout << "Random Seed: " << RandomService::seed() << "\n";
+        std::cout << "Route Queries: " << totalSearch.queries << "\n";
+        if (totalSearch.queries > 0) {
+            std::cout << "Last Query: " << lastSearch.settledNodes << " settled, "
+                      << lastSearch.relaxedEdges << " edges relaxed\n";
+            std::cout << "Avg Settled/Query: " << totalSearch.settledNodes / totalSearch.queries << "\n";
+        }
+        std::cout << "Route Cache: " << routeCache.size() << "/" << routeCache.getCapacity()
+                  << " (hits " << routeCache.hits << ", misses " << routeCache.misses
+                  << ", evictions " << routeCache.evictions << ", stale " << routeCache.staleDrops << ")\n";
+        std::cout << "Timed Route Cache: " << timedRouteCache.size() << "/" << timedRouteCache.getCapacity()
+                  << " (hits " << timedRouteCache.hits << ", misses " << timedRouteCache.misses
+                  << ", evictions " << timedRouteCache.evictions << ", stale " << timedRouteCache.staleDrops << ")\n";
+        showMetrics();
+        if (landmarkTable && landmarkTable->isReady()) {
+            std::cout << "ALT Landmarks: " << landmarkTable->landmarkCount() << "\n";
+        }
+        if (hierarchy) {
+            std::cout << "CH Shortcuts: " << hierarchy->getShortcutCount()
+                      << " (built in " << hierarchy->getBuildMillis() << " ms)\n";
+        }
         std::cout << "Current Weather: " << currentWeather << "\n";
         std::cout << "Base Fare Rate: ৳" << BASE_FARE_PER_KM << " per km\n";
         std::cout << "Student Discount: 50% OFF\n";
         std::cout << "Minimum Fare: ৳10.00\n";
         std::cout << std::string(40, '-') << "\n";
     }
+
+    // Phase latencies in microseconds and the process-wide search counters.
+    void showMetrics() const {
+        Metrics::Summary summary = Metrics::collect();
+        std::cout << "Latency (us)     count      p50      p99     p999      max\n";
+        std::cout << std::fixed << std::setprecision(1);
+        for (int p = 0; p < Metrics::PHASE_COUNT; p++) {
+            const LatencyHistogram& h = summary.phases[p];
+            std::cout << "  " << std::left << std::setw(8) << Metrics::phaseName(p) << std::right
+                      << std::setw(12) << h.count() << std::setw(9) << h.percentile(0.50) / 1e3
+                      << std::setw(9) << h.percentile(0.99) / 1e3 << std::setw(9) << h.percentile(0.999) / 1e3
+                      << std::setw(9) << h.max() / 1e3 << "\n";
+        }
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+        std::cout << "Counters: " << summary.counters[Metrics::SettledNodes] << " settled, "
+                  << summary.counters[Metrics::RelaxedEdges] << " edges relaxed, "
+                  << summary.counters[Metrics::CacheHits] << " cache hits, "
+                  << summary.counters[Metrics::CacheMisses] << " cache misses\n";
+    }
 };
 
+// Reads stop names or lat,lon pairs (whitespace separated) and writes the all-pairs distance
+// and travel-time matrix between them as tab-separated rows.
+int runMatrixJob(DhakaBusSystem& busSystem, const std::string& stopsPath, const std::string& outPath) {
+    std::ifstream input(stopsPath);
+    if (!input.is_open()) {
+        std::cout << "❌ Could not open " << stopsPath << "\n";
+        return 1;
+    }
+
+    std::vector<int> stops;
+    std::string name;
+    while (input >> name) {
+        int id = busSystem.resolveStop(name);
+        if (id < 0) {
+            std::cout << "⚠️ Unknown stop skipped: " << name << "\n";
+            continue;
+        }
+        stops.push_back(id);
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    DistanceMatrix matrix = busSystem.computeMatrix(stops, stops);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::ofstream fileOut;
+    if (!outPath.empty()) {
+        fileOut.open(outPath);
+        if (!fileOut.is_open()) {
+            std::cout << "❌ Could not write " << outPath << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : fileOut;
+    out << "from\tto\tdistance_km\ttime_min\n";
+    out << std::fixed << std::setprecision(3);
+    for (int i = 0; i < matrix.rows; i++) {
+        for (int j = 0; j < matrix.cols; j++) {
+            size_t k = static_cast<size_t>(i) * matrix.cols + j;
+            out << busSystem.getPlaceName(stops[i]) << "\t" << busSystem.getPlaceName(stops[j]) << "\t";
+            if (matrix.distanceKm[k] >= 1e18) {
+                out << "-\t-\n";
+            } else {
+                out << matrix.distanceKm[k] << "\t" << matrix.travelMinutes[k] << "\n";
+            }
+        }
+    }
+
+    std::cerr << "📐 " << matrix.rows << "x" << matrix.cols << " matrix in "
+              << std::fixed << std::setprecision(3) << seconds << " s using "
+              << busSystem.getWorkerPool().size() << " threads\n";
+    return 0;
+}
+
+// Splits off the next whitespace-separated field of rest.
+std::string_view nextField(std::string_view& rest) {
+    size_t begin = rest.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+        rest = std::string_view();
+        return rest;
+    }
+    size_t end = rest.find_first_of(" \t\r", begin);
+    if (end == std::string_view::npos) end = rest.size();
+    std::string_view field = rest.substr(begin, end - begin);
+    rest.remove_prefix(end);
+    return field;
+}
+
+// Reads "START END [y/n [HH:MM]]" rows from a file (or stdin for "-") and
+// answers them in blocks on the worker pool; rows with a departure time get
+// the fastest route for that hour. Results are written in input order and
+// numbered 1, 2, ... by seq; blank and malformed lines are skipped without
+// taking a number, and each malformed line is reported by its line number.
+// A clock in the third column is read as the departure of a non-student
+// row. Throughput is reported at the end.
+int runBatchJob(DhakaBusSystem& busSystem, const std::string& queriesPath, const std::string& outPath,
+                const std::string& format) {
+    std::ifstream fileIn;
+    if (queriesPath != "-") {
+        fileIn.open(queriesPath);
+        if (!fileIn.is_open()) {
+            std::cout << "❌ Could not open " << queriesPath << "\n";
+            return 1;
+        }
+    }
+    std::istream& input = (queriesPath == "-") ? std::cin : fileIn;
+
+    std::unique_ptr<OutputBuffer> out(outPath.empty() ? new OutputBuffer(stdout) : new OutputBuffer(outPath));
+    if (!out->isOpen()) {
+        std::cout << "❌ Could not write " << outPath << "\n";
+        return 1;
+    }
+    std::unique_ptr<RouteSink> sink;
+    if (format == "jsonl") sink.reset(new JsonLinesRouteSink(*out));
+    else if (format == "table") sink.reset(new TableRouteSink(*out));
+    else sink.reset(new TsvRouteSink(*out));
+
+    const size_t BLOCK_SIZE = 65536;
+    std::vector<std::string> names;
+    std::vector<BatchQuery> queries;
+    std::vector<BatchResult> results;
+    long long seq = 0;
+    long long unknown = 0;
+    long long unreachable = 0;
+    long long malformed = 0;
+    long long lineNumber = 0;
+    double searchSeconds = 0;
+    auto started = std::chrono::steady_clock::now();
+
+    std::string line;
+    bool more = true;
+    while (more) {
+        names.clear();
+        queries.clear();
+        while (queries.size() < BLOCK_SIZE && (more = static_cast<bool>(std::getline(input, line)))) {
+            lineNumber++;
+            std::string_view rest(line);
+            std::string_view start = nextField(rest);
+            std::string_view end = nextField(rest);
+            std::string_view student = nextField(rest);
+            std::string_view departure = nextField(rest);
+            if (start.empty()) continue;                // blank line
+            double departMinute = -1;
+            if (departure.empty() && !student.empty() &&
+                DhakaBusSystem::parseClock(std::string(student), departMinute)) {
+                departure = student;                    // "START END HH:MM"
+                student = "n";
+            }
+            const char* problem = nullptr;
+            if (end.empty()) {
+                problem = "missing END";
+            } else if (!student.empty() && student != "y" && student != "Y" && student != "n" && student != "N") {
+                problem = "student must be y or n";
+            } else if (!departure.empty() && departMinute < 0 &&
+                       !DhakaBusSystem::parseClock(std::string(departure), departMinute)) {
+                problem = "departure must be HH:MM";
+            }
+            if (problem) {
+                std::cerr << "⚠️ Line " << lineNumber << " skipped: " << problem << "\n";
+                malformed++;
+                continue;
+            }
+
+            names.emplace_back(start);
+            names.emplace_back(end);
+            BatchQuery query;
+            query.start = busSystem.resolveStop(names[names.size() - 2]);
+            query.end = busSystem.resolveStop(names.back());
+            query.student = (student == "y" || student == "Y");
+            query.departMinute = departMinute;
+            if (query.start < 0 || query.end < 0) unknown++;
+            queries.push_back(query);
+        }
+        if (queries.empty()) break;
+
+        auto blockStarted = std::chrono::steady_clock::now();
+        busSystem.answerBatch(queries, results);
+        searchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStarted).count();
+
+        RouteRecord route;
+        std::string departure, arrival;
+        for (size_t i = 0; i < queries.size(); i++) {
+            const BatchResult& result = results[i];
+            route.seq = ++seq;
+            route.from = names[2 * i];
+            route.to = names[2 * i + 1];
+            route.student = queries[i].student;
+            route.stops = result.stops;
+            route.distanceKm = result.distanceKm;
+            route.travelMinutes = result.travelMinutes;
+            route.fare = result.fare;
+            route.departure = std::string_view();
+            route.arrival = std::string_view();
+            if (queries[i].departMinute >= 0) {
+                departure = DhakaBusSystem::formatClock(queries[i].departMinute);
+                route.departure = departure;
+                if (result.stops > 0) {
+                    arrival = DhakaBusSystem::formatClock(queries[i].departMinute + result.travelMinutes);
+                    route.arrival = arrival;
+                }
+            }
+            if (result.stops == 0 && queries[i].start >= 0 && queries[i].end >= 0) unreachable++;
+            sink->write(route);
+        }
+    }
+    sink->flush();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cerr << "🧾 " << seq << " queries (" << unknown << " unknown stops, " << unreachable
+              << " without route, " << malformed << " malformed lines skipped)\n";
+    std::cerr << "⚡ " << std::fixed << std::setprecision(3) << seconds << " s total, "
+              << searchSeconds << " s searching, "
+              << std::setprecision(0) << (searchSeconds > 0 ? seq / searchSeconds : 0.0) << " queries/s using "
+              << busSystem.getWorkerPool().size() << " threads (" << searchModeName(busSystem.getSearchMode()) << ")\n";
+    return 0;
+}
+
+// Stops inside Dhaka's bounding box: 70% scatter normally around uniform
+// cluster centres (about 60 stops per cluster, 1.5-4 link radii wide), the
+// rest are spread evenly so the clusters stay linked to each other.
+std::vector<PlaceEntry> generateSyntheticCity(int count, double linkRadiusKm, Xoshiro256& rng) {
+    const double minLat = 23.65, maxLat = 23.90, minLon = 90.33, maxLon = 90.50;
+    int clusterCount = std::max(1, count / 60);
+    std::vector<PlaceEntry> centres(clusterCount);
+    std::vector<double> spreads(clusterCount);
+    for (int c = 0; c < clusterCount; c++) {
+        centres[c].lat = minLat + (maxLat - minLat) * rng.uniform();
+        centres[c].lon = minLon + (maxLon - minLon) * rng.uniform();
+        spreads[c] = linkRadiusKm * (1.5 + 2.5 * rng.uniform()) / 111.0;     // degrees
+    }
+
+    std::vector<PlaceEntry> places(count);
+    for (int i = 0; i < count; i++) {
+        places[i].name = "S" + std::to_string(i);
+        if (rng.uniform() < 0.3) {
+            places[i].lat = minLat + (maxLat - minLat) * rng.uniform();
+            places[i].lon = minLon + (maxLon - minLon) * rng.uniform();
+            continue;
+        }
+        int c = static_cast<int>(rng.below(clusterCount));
+        double radius = std::sqrt(-2.0 * std::log(1.0 - rng.uniform()));
+        double angle = 2 * 3.14159265358979 * rng.uniform();
+        places[i].lat = std::clamp(centres[c].lat + spreads[c] * radius * std::cos(angle), minLat, maxLat);
+        places[i].lon = std::clamp(centres[c].lon + spreads[c] * radius * std::sin(angle), minLon, maxLon);
+    }
+    return places;
+}
+
+// Builds a synthetic city per size and times the public entry points on a
+// fixed query set, one JSON record per (size, function). The link radius
+// shrinks with the stop count so the evenly spread stops keep about six
+// neighbours each, enough to join the city into one network. allocs_per_op
+// covers every thread, background builds included, and is null only in a
+// build with TAP_TO_RIDE_COUNT_ALLOCATIONS=0.
+int runBenchmarks(const std::string& sizesSpec, const std::string& outPath) {
+    std::vector<int> sizes;
+    std::string_view rest(sizesSpec);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view field = rest.substr(0, comma);
+        int size = 0;
+        auto parsed = std::from_chars(field.data(), field.data() + field.size(), size);
+        if (parsed.ec != std::errc() || size < 2) {
+            std::cout << "❌ Invalid --bench size: " << field << "\n";
+            return 1;
+        }
+        sizes.push_back(size);
+        rest = (comma == std::string_view::npos) ? std::string_view() : rest.substr(comma + 1);
+    }
+
+    std::ofstream fileOut;
+    if (!outPath.empty()) {
+        fileOut.open(outPath);
+        if (!fileOut.is_open()) {
+            std::cout << "❌ Could not write " << outPath << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : fileOut;
+    out << "{\n  \"seed\": " << RandomService::seed()
+        << ",\n  \"avx2\": " << (GeoKernel::hasAvx2() ? "true" : "false")
+        << ",\n  \"heap\": \"" << heapKindName(DEFAULT_HEAP) << "\""
+        << ",\n  \"counts_allocations\": " << (TAP_TO_RIDE_COUNT_ALLOCATIONS ? "true" : "false")
+        << ",\n  \"results\": [";
+    bool firstRecord = true;
+
+    for (int size : sizes) {
+        // One stream per size, so a city does not depend on the other sizes run.
+        Xoshiro256 rng = RandomService::stream((static_cast<uint64_t>(size) << 8) | RandomService::Benchmark);
+        double radiusKm = std::clamp(std::sqrt(6.0 * 480.0 / (3.14159 * 0.3 * size)), 0.02, 5.0);
+        std::vector<PlaceEntry> places = generateSyntheticCity(size, radiusKm, rng);
+        int queryCount = std::clamp(20000000 / size, 20, 1000);
+        std::vector<std::pair<int, int>> queries;
+        for (int i = 0; i < queryCount; i++) {
+            int a = static_cast<int>(rng.below(size));
+            queries.push_back(std::make_pair(a, static_cast<int>(rng.below(size))));
+        }
+
+        std::unique_ptr<DhakaBusSystem> system;
+        auto record = [&](const std::string& name, long long ops, const std::function<void()>& body) {
+            std::streambuf* console = std::cout.rdbuf(nullptr);     // the entry points print
+            unsigned long long allocationsBefore = heapAllocations.load();
+            auto started = std::chrono::steady_clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            unsigned long long allocations = heapAllocations.load() - allocationsBefore;
+            std::cout.rdbuf(console);
+            std::cout.clear();
+
+            double nsPerOp = seconds * 1e9 / ops;
+            double allocsPerOp = static_cast<double>(allocations) / ops;
+            out << (firstRecord ? "\n" : ",\n") << std::fixed << std::setprecision(3)
+                << "    {\"stops\": " << size << ", \"radius_km\": " << radiusKm
+                << ", \"edges\": " << (system ? system->getEdgeCount() : 0)
+                << ", \"name\": \"" << name << "\", \"ops\": " << ops
+                << ", \"ns_per_op\": " << nsPerOp
+                << ", \"allocs_per_op\": ";
+            if (TAP_TO_RIDE_COUNT_ALLOCATIONS) out << allocsPerOp;
+            else out << "null";             // not counted in this build
+            out << ", \"ops_per_sec\": " << (seconds > 0 ? ops / seconds : 0.0) << "}";
+            firstRecord = false;
+            std::cerr << "🏁 " << size << " stops, " << std::left << std::setw(32) << name << std::right
+                      << std::fixed << std::setw(14) << std::setprecision(0) << nsPerOp << " ns/op";
+            if (TAP_TO_RIDE_COUNT_ALLOCATIONS) std::cerr << "  " << std::setprecision(2) << allocsPerOp << " allocs/op";
+            std::cerr << "\n";
+        };
+
+        record("build_network", 1, [&] { system.reset(new DhakaBusSystem(places, radiusKm)); });
+
+        std::vector<int> path;
+        std::vector<SearchMode> modes = {SearchMode::Dijkstra, SearchMode::AStar, SearchMode::Bidirectional,
+                                         SearchMode::ContractionHierarchy};
+        record("ch_preprocess", 1, [&] { system->prepareSearch(SearchMode::ContractionHierarchy); });
+        for (SearchMode mode : modes) {
+            system->findShortestPath(queries[0].first, queries[0].second, mode, path);    // warm the workspace
+            record(std::string("findShortestPath/") + searchModeName(mode), queryCount, [&] {
+                for (auto& q : queries) system->findShortestPath(q.first, q.second, mode, path);
+            });
+        }
+
+        system->findRouteAt(queries[0].first, queries[0].second, 510, path);
+        record("findRouteAt/08:30", queryCount, [&] {
+            for (auto& q : queries) system->findRouteAt(q.first, q.second, 510, path);
+        });
+
+        std::vector<std::vector<std::string>> routes;
+        for (auto& q : queries) {
+            system->findShortestPath(q.first, q.second, SearchMode::Dijkstra, path);
+            if (path.size() < 2) continue;
+            routes.emplace_back();
+            for (int id : path) routes.back().push_back(system->getPlaceName(id));
+        }
+        if (!routes.empty()) {
+            // Tables are formatted as usual but never reach the terminal or the JSON.
+            OutputBuffer discard(static_cast<std::FILE*>(nullptr));
+            TableRouteSink table(discard);
+            record("calculateFare", static_cast<long long>(routes.size()), [&] {
+                for (auto& route : routes) system->calculateFare(route, false, 510, &table);
+            });
+        }
+    }
+
+    out << "\n  ]\n}\n";
+    return 0;
+}
+
 void displayMainMenu() {
     std::cout << "\n" << std::string(50, '=') << "\n";
     std::cout << "           🚌 DHAKA BUS ROUTE PLANNER\n";
@@ -531,46 +5487,147 @@ void displayMainMenu() {
     std::cout << "7. 🌏 Open Online Map (Google Maps)\n";
     std::cout << "8. 🔗 View Route Sequence (Text)\n";
     std::cout << "9. ❌ Exit\n";
-    std::cout << "Choose option (1-9): ";
+    std::cout << "10. ⚡ Routing Engine Report\n";
+    std::cout << "11. 🔀 Alternative Routes\n";
+    std::cout << "12. 🕒 Reachable Stops (Isochrone)\n";
+    std::cout << "13. 📡 Nearest Stops to a Location\n";
+    std::cout << "Choose option (1-13): ";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     #ifdef _WIN32
     SetConsoleOutputCP(65001);
     #endif
 
+    double radiusKm = 5.0;
+    bool verifyGraph = false;
+    SearchMode searchMode = SearchMode::Dijkstra;
+    int threads = 0;
+    HeapKind heapKind = DEFAULT_HEAP;
+    std::string matrixPath;
+    std::string batchPath;
+    std::string benchSizes;
+    bool seedGiven = false;
+    std::string outPath;
+    std::string metricsPath;
+    std::string format = "tsv";
+    int metricsInterval = 10;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--radius=", 0) == 0) {
+            radiusKm = std::atof(arg.c_str() + 9);
+            if (radiusKm <= 0) {
+                std::cout << "❌ Invalid --radius, using 5 km\n";
+                radiusKm = 5.0;
+            }
+        } else if (arg == "--verify-graph") {
+            verifyGraph = true;
+        } else if (arg.rfind("--search=", 0) == 0) {
+            if (!parseSearchMode(arg.substr(9), searchMode)) {
+                std::cout << "❌ Unknown --search mode, using dijkstra\n";
+            }
+        } else if (arg.rfind("--heap=", 0) == 0) {
+            if (!parseHeapKind(arg.substr(7), heapKind)) {
+                std::cout << "❌ Unknown --heap, using " << heapKindName(DEFAULT_HEAP) << "\n";
+            }
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            threads = std::atoi(arg.c_str() + 10);
+        } else if (arg.rfind("--matrix=", 0) == 0) {
+            matrixPath = arg.substr(9);
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            RandomService::setSeed(std::strtoull(arg.c_str() + 7, nullptr, 10));
+            seedGiven = true;
+        } else if (arg == "--bench") {
+            benchSizes = "1000,10000,100000,1000000";
+        } else if (arg.rfind("--bench=", 0) == 0) {
+            benchSizes = arg.substr(8);
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            batchPath = arg.substr(8);
+        } else if (arg.rfind("--out=", 0) == 0) {
+            outPath = arg.substr(6);
+        } else if (arg.rfind("--format=", 0) == 0) {
+            format = arg.substr(9);
+            if (format != "tsv" && format != "jsonl" && format != "table") {
+                std::cout << "❌ Unknown --format, using tsv\n";
+                format = "tsv";
+            }
+        } else if (arg.rfind("--metrics=", 0) == 0) {
+            metricsPath = arg.substr(10);
+        } else if (arg.rfind("--metrics-interval=", 0) == 0) {
+            metricsInterval = std::atoi(arg.c_str() + 19);
+            if (metricsInterval <= 0) {
+                std::cout << "❌ Invalid --metrics-interval, using 10 s\n";
+                metricsInterval = 10;
+            }
+        }
+    }
+
+    // Declared before the system so the final dump sees everything it recorded.
+    std::unique_ptr<MetricsDumper> metricsDumper;
+    if (!metricsPath.empty()) {
+        metricsDumper.reset(new MetricsDumper(metricsPath, metricsInterval));
+    }
+
+    if (!benchSizes.empty()) {
+        if (!seedGiven) RandomService::setSeed(1);     // same cities and queries every run
+        return runBenchmarks(benchSizes, outPath);
+    }
+
     std::cout << "Starting Dhaka Bus Route Planner...\n";
-    DhakaBusSystem busSystem;
+    DhakaBusSystem busSystem(radiusKm);
+    busSystem.setVerifyIncremental(verifyGraph);
+    busSystem.setSearchMode(searchMode);
+    busSystem.setWorkerThreads(threads);
+    busSystem.setHeapKind(heapKind);
+
+    if (!matrixPath.empty()) {
+        return runMatrixJob(busSystem, matrixPath, outPath);
+    }
+    if (!batchPath.empty()) {
+        return runBatchJob(busSystem, batchPath, outPath, format);
+    }
 
     int choice;
     do {
         displayMainMenu();
-        std::cin >> choice;
+        if (!(std::cin >> choice)) break;   // end of input
 
         switch(choice) {
             case 1: {
-                std::string start, end;
+                std::string start, end, departure;
                 char student;
 
-                busSystem.showAllPlaces();
+                busSystem.showPlacePrompt();
 
                 std::cout << "\nEnter START location: ";
                 std::cin >> start;
+                if (!busSystem.resolvePlace(start)) {
+                    std::cout << "❌ Error: Invalid location name!\n";
+                    break;
+                }
 
                 std::cout << "Enter END location: ";
                 std::cin >> end;
+                if (!busSystem.resolvePlace(end)) {
+                    std::cout << "❌ Error: Invalid location name!\n";
+                    break;
+                }
 
                 std::cout << "Student discount? (y/n): ";
                 std::cin >> student;
 
-                if (!busSystem.placeExists(start) || !busSystem.placeExists(end)) {
-                    std::cout << "❌ Error: Invalid location name!\n";
-                    break;
+                std::cout << "Departure time (HH:MM or now): ";
+                std::cin >> departure;
+                double departMinute;
+                if (!DhakaBusSystem::parseClock(departure, departMinute)) {
+                    std::cout << "⚠️ Invalid time, using now\n";
+                    departMinute = DhakaBusSystem::currentMinute();
                 }
 
-                std::vector<std::string> path = busSystem.findShortestPath(start, end);
+                // Fastest route for the hour of departure, "now" included.
+                std::vector<std::string> path = busSystem.findRouteAt(start, end, departMinute);
                 if (!path.empty()) {
-                    busSystem.calculateFare(path, (student == 'y' || student == 'Y'));
+                    busSystem.calculateFare(path, (student == 'y' || student == 'Y'), departMinute);
                 } else {
                     std::cout << "❌ No route found between " << start << " and " << end << "!\n";
                 }
@@ -601,6 +5658,18 @@ int main() {
                 std::cout << "\n🙏 Thank you for using Dhaka Bus Route Planner!\n";
                 std::cout << "🚌 Safe travels! 🌟\n";
                 break;
+            case 10:
+                busSystem.showRoutingReport();
+                break;
+            case 11:
+                busSystem.showAlternativeRoutes();
+                break;
+            case 12:
+                busSystem.showReachableStops();
+                break;
+            case 13:
+                busSystem.showNearestStops();
+                break;
             default:
                 std::cout << "❌ Invalid choice! Please try again.\n";
         }